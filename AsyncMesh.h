@@ -0,0 +1,46 @@
+#ifndef ASYNC_MESH_H_INCLUDED
+#define ASYNC_MESH_H_INCLUDED
+
+#include <future>
+#include <chrono>
+
+#include "Mesh.h"
+#include "MTLLoader.h"
+
+/// a mesh being loaded on other threads (see OBJLoader::loadMeshAsync), the
+/// geometry and the materials are read there, the textures are loaded by get
+/// because they need the gl context
+template <typename VertexType>
+class AsyncMesh {
+public:
+	std::future <Mesh<VertexType>> future;
+
+	bool lazyTextures = false;	/// get leaves the textures to the drawers
+
+	AsyncMesh() {}
+
+	AsyncMesh (std::future<Mesh<VertexType>>&& future) : future(std::move(future)) {}
+
+	/// true once get only has to load the textures
+	bool isReady() const {
+		return future.valid() &&
+				future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+	}
+
+	void wait() const {
+		future.wait();
+	}
+
+	/// call it once, on the thread that owns the gl context, it waits for the
+	/// load if it's not done and throws what the load threw
+	Mesh<VertexType> get() {
+		Mesh<VertexType> mesh = future.get();
+		if (!lazyTextures)
+			MTLLoader::loadTextures(mesh.materials);
+		mesh.updateRenderMaterials();
+
+		return mesh;
+	}
+};
+
+#endif
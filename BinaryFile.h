@@ -0,0 +1,115 @@
+#ifndef BINARY_FILE_H_INCLUDED
+#define BINARY_FILE_H_INCLUDED
+
+#include <string>
+#include <fstream>
+#include <cstring>
+#include <cstdint>
+#include <cstdio>
+
+/// reads the fields of a cache file in place (native endianess, no padding);
+/// a read past the end fails and so do all the ones after it, check ok once
+/// at the end
+class BinaryReader {
+public:
+	const char *cur;
+	const char *end;
+	bool ok = true;
+
+	BinaryReader (const char *begin, const char *end) : cur(begin), end(end) {}
+
+	size_t left() {
+		return end - cur;
+	}
+
+	void get (void *data, size_t size) {
+		if (!ok || left() < size) {
+			ok = false;
+			return;
+		}
+		memcpy(data, cur, size);
+		cur += size;
+	}
+
+	uint64_t getU64() {
+		uint64_t value = 0;
+		get(&value, sizeof(value));
+		return value;
+	}
+
+	std::string getStr() {
+		uint64_t size = getU64();
+		if (!ok || left() < size) {
+			ok = false;
+			return std::string();
+		}
+		std::string str(cur, size);
+		cur += size;
+		return str;
+	}
+
+	/// counts are checked against what is left so a bad file can't make us allocate
+	uint64_t getCount (size_t elemSize) {
+		uint64_t count = getU64();
+		if (!ok || left() / elemSize < count) {
+			ok = false;
+			return 0;
+		}
+		return count;
+	}
+};
+
+/// writes a cache file next to path and renames it once it's complete, so a
+/// reader never sees half of it; without a commit the file is dropped
+class BinaryWriter {
+public:
+	std::string path;
+	std::string tmpPath;
+	std::ofstream file;
+
+	BinaryWriter() {}
+
+	BinaryWriter (const BinaryWriter& other) = delete;
+	BinaryWriter& operator = (const BinaryWriter& other) = delete;
+
+	~BinaryWriter() {
+		if (file.is_open()) {
+			file.close();
+			std::remove(tmpPath.c_str());
+		}
+	}
+
+	bool open (std::string filePath) {
+		path = filePath;
+		tmpPath = path + ".tmp";
+		file.open(tmpPath.c_str(), std::ios::binary | std::ios::trunc);
+		return (bool)file;
+	}
+
+	void put (const void *data, size_t size) {
+		file.write((const char *)data, size);
+	}
+
+	void putU64 (uint64_t value) {
+		put(&value, sizeof(value));
+	}
+
+	void putStr (const std::string& str) {
+		putU64(str.size());
+		put(str.data(), str.size());
+	}
+
+	/// false if some write failed, the old file is then kept
+	bool commit() {
+		file.close();
+		if (!file) {
+			std::remove(tmpPath.c_str());
+			return false;
+		}
+
+		std::remove(path.c_str());
+		return std::rename(tmpPath.c_str(), path.c_str()) == 0;
+	}
+};
+
+#endif
@@ -0,0 +1,321 @@
+#ifndef COMPRESSED_FILE_H_INCLUDED
+#define COMPRESSED_FILE_H_INCLUDED
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <stdexcept>
+#include <cstdio>
+#include <cstring>
+
+#ifdef MESH_USE_ZLIB
+#include <zlib.h>
+#endif
+
+#ifdef MESH_USE_ZSTD
+#include <zstd.h>
+#endif
+
+/// reads .gz (MESH_USE_ZLIB, -lz) and .zst (MESH_USE_ZSTD, -lzstd) files;
+/// a second thread decompresses blocks into a small bounded queue while the
+/// caller parses the blocks it already has, so memory stays at a few blocks
+/// no matter how big the file is
+class CompressedFile {
+public:
+	static const int NONE = 0;
+	static const int GZIP = 1;
+	static const int ZSTD = 2;
+
+	static const size_t BLOCK_SIZE = 1 << 22;
+	static const size_t QUEUE_SIZE = 4;
+
+	static bool endsWith (const std::string& str, const std::string& suffix) {
+		return str.size() >= suffix.size() &&
+				str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+	}
+
+	static int format (const std::string& path) {
+		if (endsWith(path, ".gz"))
+			return GZIP;
+		if (endsWith(path, ".zst"))
+			return ZSTD;
+		return NONE;
+	}
+
+	static bool isCompressed (const std::string& path) {
+		return format(path) != NONE;
+	}
+
+	/// decompressed blocks handed from the decoder thread to the parser
+	class BlockQueue {
+	public:
+		std::mutex mutex;
+		std::condition_variable changed;
+
+		std::deque <std::vector<char>> full;
+		std::vector <std::vector<char>> free;
+		bool done = false;
+		bool cancel = false;
+		std::string error;
+
+		/// false if the reader gave up, the decoder should stop
+		bool push (std::vector<char>& block) {
+			std::unique_lock<std::mutex> lock(mutex);
+			changed.wait(lock, [&] { return full.size() < QUEUE_SIZE || cancel; });
+
+			if (cancel)
+				return false;
+
+			full.push_back(std::move(block));
+			block = takeFree();
+			changed.notify_all();
+			return true;
+		}
+
+		/// false when there are no more blocks
+		bool pop (std::vector<char>& block) {
+			std::unique_lock<std::mutex> lock(mutex);
+			changed.wait(lock, [&] { return full.size() || done; });
+
+			if (block.capacity())
+				free.push_back(std::move(block));
+
+			if (full.empty())
+				return false;
+
+			block = std::move(full.front());
+			full.pop_front();
+			changed.notify_all();
+			return true;
+		}
+
+		void finish (std::string errorMsg = "") {
+			std::lock_guard<std::mutex> lock(mutex);
+			done = true;
+			error = errorMsg;
+			changed.notify_all();
+		}
+
+		void stop() {
+			std::lock_guard<std::mutex> lock(mutex);
+			cancel = true;
+			changed.notify_all();
+		}
+
+		/// mutex must be held
+		std::vector<char> takeFree() {
+			std::vector<char> block;
+			if (free.size()) {
+				block = std::move(free.back());
+				free.pop_back();
+			}
+
+			block.clear();
+			block.reserve(BLOCK_SIZE);
+			return block;
+		}
+	};
+
+	/// calls func(lineBegin, lineEnd) for every line of the decompressed file,
+	/// the '\n' is not part of the line, the same as forEachLine in TextParse.h
+	template <typename FuncType>
+	static void forEachLine (std::string path, FuncType&& func) {
+		FILE *file = fopen(path.c_str(), "rb");
+		if (!file)
+			throw std::runtime_error("file not found: " + path);
+
+		int fileFormat = format(path);
+		BlockQueue queue;
+
+		std::thread decoder([&] {
+			std::string error;
+
+			try {
+				decode(file, fileFormat, queue);
+			}
+			catch (std::exception& e) {
+				error = e.what();
+			}
+
+			queue.finish(error);
+		});
+
+		/// a line cut by the end of a block waits here for the rest of it
+		std::string carry;
+		std::vector<char> block;
+
+		try {
+			while (queue.pop(block)) {
+				const char *cur = block.data();
+				const char *end = block.data() + block.size();
+
+				if (carry.size()) {
+					const char *lineEnd = (const char *)memchr(cur, '\n', end - cur);
+					if (lineEnd == nullptr) {
+						carry.append(cur, end);
+						continue;
+					}
+
+					carry.append(cur, lineEnd);
+					func(carry.data(), carry.data() + carry.size());
+					carry.clear();
+					cur = lineEnd + 1;
+				}
+
+				while (cur < end) {
+					const char *lineEnd = (const char *)memchr(cur, '\n', end - cur);
+					if (lineEnd == nullptr) {
+						carry.assign(cur, end);
+						break;
+					}
+
+					func(cur, lineEnd);
+					cur = lineEnd + 1;
+				}
+			}
+		}
+		catch (...) {
+			queue.stop();
+			decoder.join();
+			fclose(file);
+			throw;
+		}
+
+		decoder.join();
+		fclose(file);
+
+		if (queue.error != "")
+			throw std::runtime_error(queue.error + ": " + path);
+
+		if (carry.size())
+			func(carry.data(), carry.data() + carry.size());
+	}
+
+	static void decode (FILE *file, int fileFormat, BlockQueue& queue) {
+		std::vector<char> block;
+		{
+			std::lock_guard<std::mutex> lock(queue.mutex);
+			block = queue.takeFree();
+		}
+
+		/// copies decompressed bytes in blocks, false if the reader stopped
+		auto emit = [&] (const char *data, size_t size) {
+			while (size) {
+				size_t part = std::min(size, BLOCK_SIZE - block.size());
+				block.insert(block.end(), data, data + part);
+				data += part;
+				size -= part;
+
+				if (block.size() == BLOCK_SIZE && !queue.push(block))
+					return false;
+			}
+			return true;
+		};
+		(void)emit;		/// unused when built without zlib and zstd
+
+		std::vector<char> input(1 << 18);
+		std::vector<char> output(1 << 18);
+
+		if (fileFormat == GZIP) {
+#ifdef MESH_USE_ZLIB
+			z_stream stream;
+			memset(&stream, 0, sizeof(stream));
+
+			/// 16 + MAX_WBITS: gzip header and trailer
+			if (inflateInit2(&stream, 16 + MAX_WBITS) != Z_OK)
+				throw std::runtime_error("inflateInit2 failed");
+
+			int ret = Z_OK;
+			int members = 0;		/// read to their end
+			bool ok = true;
+			bool garbage = false;	/// after the last member
+			while (ok && !garbage) {
+				stream.avail_in = fread(input.data(), 1, input.size(), file);
+				stream.next_in = (Bytef *)input.data();
+
+				if (stream.avail_in == 0)
+					break;
+
+				/// a full output buffer may mean there is more to flush
+				do {
+					stream.avail_out = output.size();
+					stream.next_out = (Bytef *)output.data();
+
+					ret = inflate(&stream, Z_NO_FLUSH);
+					if (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR) {
+						/// bytes after a member that don't start another one are
+						/// ignored, as gzip does
+						if (members > 0 && stream.total_out == 0) {
+							garbage = true;
+							break;
+						}
+
+						inflateEnd(&stream);
+						throw std::runtime_error("corrupt gzip data");
+					}
+
+					ok = emit(output.data(), output.size() - stream.avail_out);
+
+					/// gzip files can be many members back to back
+					if (ret == Z_STREAM_END) {
+						members++;
+						inflateReset(&stream);
+					}
+				} while (ok && (stream.avail_in || stream.avail_out == 0));
+			}
+
+			/// the input ended inside a member
+			bool truncated = ok && !garbage && (members == 0 || stream.total_in != 0);
+			inflateEnd(&stream);
+
+			if (truncated)
+				throw std::runtime_error("truncated gzip data");
+#else
+			throw std::runtime_error("built without MESH_USE_ZLIB, can't read .gz");
+#endif
+		}
+		else if (fileFormat == ZSTD) {
+#ifdef MESH_USE_ZSTD
+			ZSTD_DStream *stream = ZSTD_createDStream();
+			ZSTD_initDStream(stream);
+
+			size_t ret = 1;	/// 0 once a frame is complete and flushed
+			bool ok = true;
+			while (ok) {
+				size_t read = fread(input.data(), 1, input.size(), file);
+				if (read == 0)
+					break;
+
+				ZSTD_inBuffer in = {input.data(), read, 0};
+				ZSTD_outBuffer out;
+				do {
+					out = {output.data(), output.size(), 0};
+
+					ret = ZSTD_decompressStream(stream, &out, &in);
+					if (ZSTD_isError(ret)) {
+						ZSTD_freeDStream(stream);
+						throw std::runtime_error("corrupt zstd data");
+					}
+
+					ok = emit(output.data(), out.pos);
+				} while (ok && (in.pos < in.size || out.pos == out.size));
+			}
+
+			ZSTD_freeDStream(stream);
+
+			if (ok && ret != 0)
+				throw std::runtime_error("truncated zstd data");
+#else
+			throw std::runtime_error("built without MESH_USE_ZSTD, can't read .zst");
+#endif
+		}
+
+		if (block.size())
+			queue.push(block);
+	}
+};
+
+#endif
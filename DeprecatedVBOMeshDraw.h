@@ -2,6 +2,7 @@
 #define DEPRECATED_VBO_MESH_DRAW_H_INCLUDED
 
 #include "Mesh.h"
+#include "FixedFunctionMeshDraw.h"
 
 class DeprecatedVBOMeshDraw {
 public:
@@ -21,6 +22,16 @@ public:
 	int triangleCount = 0;
 	int quadCount = 0;
 
+	/// for meshes grouped by material (Mesh::groupByMaterial), the triangles
+	/// of every SubMesh are one range of the triangle buffer, drawn with one
+	/// glDrawElements after binding its material
+	struct Batch {
+		MaterialRenderData material;
+		int first;	/// in indexes
+		int count;
+	};
+	std::vector <Batch> batches;
+
 	bool isFree = true;
 
 	DeprecatedVBOMeshDraw() {}
@@ -55,6 +66,8 @@ public:
 		triangleCount = other.triangleCount;
 		quadCount = other.quadCount;
 
+		batches = std::move(other.batches);
+
 		isFree = false;
 		other.isFree = true;
 
@@ -66,7 +79,7 @@ public:
 		if (mesh.vertexList.size() == 0)
 			return;
 
-		if (mesh.elementIndex.size() == 0)
+		if (mesh.elementIndex.size() == 0 && mesh.triangleIndex.size() == 0)
 			return;
 
 		isFree = false;
@@ -79,38 +92,67 @@ public:
 		glGenVertexArrays(1, (GLuint*)&vao);
 		glBindVertexArray(vao);
 
-		for (int i = 0; i < mesh.elementIndex.size(); i++) {
-			auto& face = mesh.elementIndex[i];
+		auto addFaces = [&] (int begin, int end) {
+			for (int i = begin; i < end; i++) {
+				auto face = mesh.elementIndex[i];
 
-			if (face.size() == 1) {
-				pointCount++;
-				for (auto&& index : face) {
-					pointElemnts.push_back(index);
+				if (face.size() == 1) {
+					pointCount++;
+					for (auto&& index : face) {
+						pointElemnts.push_back(index);
+					}
 				}
-			}
 
-			if (face.size() == 2) {
-				lineCount++;
-				for (auto&& index : face) {
-					lineElemnts.push_back(index);
+				if (face.size() == 2) {
+					lineCount++;
+					for (auto&& index : face) {
+						lineElemnts.push_back(index);
+					}
 				}
-			}
 
-			if (face.size() == 3) {
-				triangleCount++;
-				for (auto&& index : face) {
-					triangleElemnts.push_back(index);
+				if (face.size() == 3) {
+					for (auto&& index : face) {
+						triangleElemnts.push_back(index);
+					}
 				}
-			}
 
-			if (face.size() == 4) {
-				quadCount++;
-				for (auto&& index : face) {
-					quadElemnts.push_back(index);
+				if (face.size() == 4) {
+					quadCount++;
+					for (auto&& index : face) {
+						quadElemnts.push_back(index);
+					}
 				}
 			}
+		};
+
+		if (mesh.subMeshes.size() == 0) {
+			addFaces(0, mesh.elementIndex.size());
+
+			/// triangulated faces are already laid out for GL_TRIANGLES
+			triangleElemnts.insert(triangleElemnts.end(), mesh.triangleIndex.begin(),
+					mesh.triangleIndex.end());
+		}
+		else {
+			if (mesh.renderMaterials.size() != mesh.materials.size())
+				mesh.updateRenderMaterials();
+
+			for (auto&& subMesh : mesh.subMeshes) {
+				int first = triangleElemnts.size();
+
+				addFaces(subMesh.faceBegin, subMesh.faceBegin + subMesh.faceCount);
+				triangleElemnts.insert(triangleElemnts.end(),
+						mesh.triangleIndex.begin() + subMesh.triangleBegin * 3,
+						mesh.triangleIndex.begin() + (subMesh.triangleBegin + subMesh.triangleCount) * 3);
+
+				if (triangleElemnts.size() != first)
+					batches.push_back({mesh.getRenderMaterial(subMesh.material,
+							1u << MaterialRenderData::DIFUSE), first,
+							(int)triangleElemnts.size() - first});
+			}
 		}
 
+		triangleCount = triangleElemnts.size() / 3;
+
 		auto storeElements = [] (int &indexVBO, std::vector<int>& buffer) {
 			if (buffer.size() == 0) {
 				indexVBO = INDEX_INVALID;
@@ -181,7 +223,16 @@ public:
 			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 		}
 
-		if (indexTriangleVBO != INDEX_INVALID) {
+		if (indexTriangleVBO != INDEX_INVALID && batches.size() != 0) {
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexTriangleVBO);
+			for (auto&& batch : batches) {
+				FixedFunctionMeshDraw::useMaterial(batch.material, shader);
+				glDrawElements(GL_TRIANGLES, batch.count, GL_UNSIGNED_INT,
+						(char*)NULL + batch.first * sizeof(int));
+			}
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+		}
+		else if (indexTriangleVBO != INDEX_INVALID) {
 			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexTriangleVBO);
 			glDrawElements(GL_TRIANGLES, triangleCount * 3, GL_UNSIGNED_INT, (char*)NULL + 0);
 			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
@@ -72,7 +72,7 @@ public:
 		if (mesh.vertexList.size() == 0)
 			return;
 
-		if (mesh.elementIndex.size() == 0)
+		if (mesh.elementIndex.size() == 0 && mesh.triangleIndex.size() == 0)
 			return;
 
 		isFree = false;
@@ -86,7 +86,7 @@ public:
 		glBindVertexArray(vao);
 
 		for (int i = 0; i < mesh.elementIndex.size(); i++) {
-			auto& face = mesh.elementIndex[i];
+			auto face = mesh.elementIndex[i];
 
 			if (face.size() == 1) {
 				pointCount++;
@@ -117,6 +117,11 @@ public:
 			}
 		}
 
+		/// triangulated faces are already laid out for GL_TRIANGLES
+		triangleElemnts.insert(triangleElemnts.end(), mesh.triangleIndex.begin(),
+				mesh.triangleIndex.end());
+		triangleCount += mesh.triangleIndex.size() / 3;
+
 		auto storeElements = [] (int &indexVBO, std::vector<int>& buffer) {
 			if (buffer.size() == 0) {
 				indexVBO = INDEX_INVALID;
@@ -223,7 +228,7 @@ public:
 		glBindVertexArray(vao);
 
 		for (int i = start; i < mesh.elementIndex.size() && i < start + size; i++) {
-			auto& face = mesh.elementIndex[i];
+			auto face = mesh.elementIndex[i];
 
 			if (face.size() == 1) {
 				pointCount++;
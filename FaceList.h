@@ -0,0 +1,172 @@
+#ifndef FACE_LIST_H_INCLUDED
+#define FACE_LIST_H_INCLUDED
+
+#include <vector>
+#include <initializer_list>
+#include <utility>
+#include <cstddef>
+
+/// the corners of one face, pointers in the indexes of a FaceList, valid
+/// until the list grows
+template <typename IntType>
+class FaceSpan {
+public:
+	IntType *first;
+	IntType *last;
+
+	FaceSpan (IntType *first, IntType *last) : first(first), last(last) {}
+
+	IntType *begin() const { return first; }
+	IntType *end() const { return last; }
+	IntType *data() const { return first; }
+
+	size_t size() const { return last - first; }
+	bool empty() const { return first == last; }
+
+	IntType& operator [] (size_t i) const { return first[i]; }
+};
+
+/// the faces of a mesh in two flat arrays (compressed sparse rows): the
+/// corners of all the faces back to back in indexes, and where each face
+/// starts in offsets, so a face costs one int besides its corners and the
+/// faces are walked in order without a pointer per face
+///
+/// face i is indexes[offsets[i]] to indexes[offsets[i + 1]], offsets always
+/// holds size() + 1 entries starting with 0
+class FaceList {
+public:
+	using Face = FaceSpan<int>;
+	using ConstFace = FaceSpan<const int>;
+
+	std::vector <int> offsets;
+	std::vector <int> indexes;
+
+	FaceList() : offsets(1, 0) {}
+
+	FaceList (const FaceList& other) = default;
+	FaceList& operator = (const FaceList& other) = default;
+
+	/// other is left empty, not without its first offset
+	FaceList (FaceList&& other) noexcept : offsets(std::move(other.offsets)),
+			indexes(std::move(other.indexes))
+	{
+		other.clear();
+	}
+
+	FaceList& operator = (FaceList&& other) noexcept {
+		if (this != &other) {
+			offsets = std::move(other.offsets);
+			indexes = std::move(other.indexes);
+			other.clear();
+		}
+
+		return *this;
+	}
+
+	size_t size() const {
+		return offsets.size() - 1;
+	}
+
+	bool empty() const {
+		return size() == 0;
+	}
+
+	/// corners of all the faces
+	size_t cornerCount() const {
+		return indexes.size();
+	}
+
+	/// keeps the memory for the next faces
+	void clear() {
+		offsets.assign(1, 0);
+		indexes.clear();
+	}
+
+	void reserve (size_t faceCount, size_t corners) {
+		offsets.reserve(faceCount + 1);
+		indexes.reserve(corners);
+	}
+
+	Face operator [] (size_t i) {
+		return Face(indexes.data() + offsets[i], indexes.data() + offsets[i + 1]);
+	}
+
+	ConstFace operator [] (size_t i) const {
+		return ConstFace(indexes.data() + offsets[i], indexes.data() + offsets[i + 1]);
+	}
+
+	Face back() {
+		return (*this)[size() - 1];
+	}
+
+	ConstFace back() const {
+		return (*this)[size() - 1];
+	}
+
+	/// starts an empty face at the end, addCorner fills it
+	void addFace() {
+		offsets.push_back(indexes.size());
+	}
+
+	/// a corner at the end of the last face
+	void addCorner (int index) {
+		indexes.push_back(index);
+		offsets.back()++;
+	}
+
+	template <typename IteratorType>
+	void push_back (IteratorType begin, IteratorType end) {
+		indexes.insert(indexes.end(), begin, end);
+		offsets.push_back(indexes.size());
+	}
+
+	void push_back (std::initializer_list<int> face) {
+		push_back(face.begin(), face.end());
+	}
+
+	template <typename IntType>
+	void push_back (FaceSpan<IntType> face) {
+		push_back(face.begin(), face.end());
+	}
+
+	void pop_back() {
+		offsets.pop_back();
+		indexes.resize(offsets.back());
+	}
+
+	/// the faces of other after the ones already there
+	void append (const FaceList& other) {
+		int base = indexes.size();
+
+		offsets.reserve(offsets.size() + other.size());
+		for (size_t i = 1; i < other.offsets.size(); i++)
+			offsets.push_back(base + other.offsets[i]);
+
+		indexes.insert(indexes.end(), other.indexes.begin(), other.indexes.end());
+	}
+
+	/// walks the faces as spans, for range for
+	template <typename ListType, typename FaceType>
+	class Iterator {
+	public:
+		ListType *list;
+		size_t i;
+
+		Iterator (ListType *list, size_t i) : list(list), i(i) {}
+
+		FaceType operator * () const { return (*list)[i]; }
+		Iterator& operator ++ () { i++; return *this; }
+		bool operator != (const Iterator& other) const { return i != other.i; }
+		bool operator == (const Iterator& other) const { return i == other.i; }
+	};
+
+	using iterator = Iterator<FaceList, Face>;
+	using const_iterator = Iterator<const FaceList, ConstFace>;
+
+	iterator begin() { return iterator(this, 0); }
+	iterator end() { return iterator(this, size()); }
+	const_iterator begin() const { return const_iterator(this, 0); }
+	const_iterator end() const { return const_iterator(this, size()); }
+};
+
+#endif
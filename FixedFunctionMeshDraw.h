@@ -31,25 +31,29 @@ public:
 		);
 	}
 
-	static void useMaterial (Material material, ShaderProgram& shader) {
+	static void useMaterial (const MaterialRenderData& material, ShaderProgram& shader) {
 		glColor4fv(material.difuseColor.getPtr());
 
 		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, material.difuseTexture.openglTexture);
+		glBindTexture(GL_TEXTURE_2D, material.textures[MaterialRenderData::DIFUSE]);
 
 		shader.setInt("texture", 0);
 	} 
 
 	template <typename VertexType>
 	static void draw (Mesh<VertexType>& mesh, ShaderProgram& shader) {
+		if (mesh.renderMaterials.size() != mesh.materials.size())
+			mesh.updateRenderMaterials();
+
 		int currentMaterial = -2; 
 		for (int i = 0; i < mesh.elementIndex.size(); i++) {
-			auto& face = mesh.elementIndex[i];
+			auto face = mesh.elementIndex[i];
 			
 			if (currentMaterial != mesh.materialIndex[i]){
 				currentMaterial = mesh.materialIndex[i];
 
-				useMaterial(mesh.getMaterialByIndex(currentMaterial), shader); 
+				useMaterial(mesh.getRenderMaterial(currentMaterial,
+						1u << MaterialRenderData::DIFUSE), shader); 
 			}
 
 			if (face.size() == 0) {
@@ -91,6 +95,23 @@ public:
 				glEnd();	
 			}
 		}
+
+		/// triangulated faces, one glBegin for each run of the same material
+		for (int i = 0; i < mesh.triangleMaterialIndex.size(); ) {
+			currentMaterial = mesh.triangleMaterialIndex[i];
+			useMaterial(mesh.getRenderMaterial(currentMaterial, 1u << MaterialRenderData::DIFUSE),
+					shader); 
+
+			glBegin(GL_TRIANGLES);
+				for (; i < mesh.triangleMaterialIndex.size() &&
+						mesh.triangleMaterialIndex[i] == currentMaterial; i++)
+				{
+					drawVertex(mesh.vertexList[mesh.triangleIndex[i * 3]]);
+					drawVertex(mesh.vertexList[mesh.triangleIndex[i * 3 + 1]]);
+					drawVertex(mesh.vertexList[mesh.triangleIndex[i * 3 + 2]]);
+				}
+			glEnd();
+		}
 	}
 };
 
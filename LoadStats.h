@@ -0,0 +1,208 @@
+#ifndef LOAD_STATS_H_INCLUDED
+#define LOAD_STATS_H_INCLUDED
+
+#include <cstdint>
+#include <cstddef>
+#include <chrono>
+#include <ostream>
+#include <algorithm>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#define LOAD_STATS_RDTSC
+#endif
+
+#include "ObjPrescan.h"
+
+/// what OBJLoader did during the last load, only collected if the loader is
+/// built with MESH_LOADER_STATS, else every call here is empty and the
+/// fields stay 0
+///
+/// the phases are a stack: entering a phase pauses the one that was running,
+/// so the times add up to the whole load; they are read with rdtsc and
+/// converted to seconds with the wall time of the load, so timing a corner
+/// costs a few ns
+class LoadStats {
+public:
+#ifdef MESH_LOADER_STATS
+	static constexpr bool enabled = true;
+#else
+	static constexpr bool enabled = false;
+#endif
+
+	static const int OTHER = 0;
+	static const int READ = 1;		/// opening, mapping, reading and prescanning the file
+	static const int TOKENIZE = 2;	/// splitting lines and parsing numbers
+	static const int DEDUP = 3;		/// looking up corners in the vertex map
+	static const int ASSEMBLY = 4;	/// building vertexes and moving faces in the mesh
+	static const int MTL = 5;		/// parsing mtl files, textures not included
+	static const int TEXTURE = 6;	/// loading textures
+	static const int PHASE_COUNT = 7;
+
+	size_t bytesRead = 0;
+
+	size_t positionLines = 0;
+	size_t normalLines = 0;
+	size_t texCoordLines = 0;
+	size_t faceLines = 0;
+	size_t usemtlLines = 0;
+	size_t mtllibLines = 0;
+	size_t otherLines = 0;
+
+	size_t corners = 0;
+	size_t uniqueVertexes = 0;
+
+	double totalTime = 0;
+	double phaseTime[PHASE_COUNT] = {};
+
+	/// largest sizes the containers reached
+	size_t peakPositions = 0;
+	size_t peakNormals = 0;
+	size_t peakTexCoords = 0;
+	size_t peakFaces = 0;
+	size_t peakVertexes = 0;
+	size_t peakIndexMapSlots = 0;
+
+	/// share of the corners that found an existing vertex
+	double dedupHitRate() const {
+		return corners ? 1.0 - (double)uniqueVertexes / corners : 0;
+	}
+
+	static uint64_t ticks() {
+#ifdef LOAD_STATS_RDTSC
+		return __rdtsc();
+#else
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(
+				std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+	}
+
+	void begin() {
+		if constexpr (enabled) {
+			*this = LoadStats();
+			startTime = std::chrono::steady_clock::now();
+			startTick = lastTick = ticks();
+		}
+	}
+
+	void end() {
+		if constexpr (enabled) {
+			enter(OTHER);
+
+			totalTime = std::chrono::duration<double>(
+					std::chrono::steady_clock::now() - startTime).count();
+
+			double secondsPerTick = lastTick > startTick ? totalTime / (lastTick - startTick) : 0;
+			for (int i = 0; i < PHASE_COUNT; i++)
+				phaseTime[i] = phaseTicks[i] * secondsPerTick;
+		}
+	}
+
+	/// returns the phase that was running
+	int enter (int phase) {
+		if constexpr (enabled) {
+			uint64_t now = ticks();
+			phaseTicks[currentPhase] += now - lastTick;
+			lastTick = now;
+
+			int previous = currentPhase;
+			currentPhase = phase;
+			return previous;
+		}
+		return OTHER;
+	}
+
+	/// runs a phase until the end of the scope, stats can be null
+	class Scope {
+	public:
+		LoadStats *stats;
+		int previous = OTHER;
+
+		Scope (LoadStats *stats, int phase) : stats(stats) {
+			if constexpr (enabled)
+				if (stats)
+					previous = stats->enter(phase);
+		}
+
+		~Scope() {
+			if constexpr (enabled)
+				if (stats)
+					stats->enter(previous);
+		}
+	};
+
+	void addBytes (size_t bytes) {
+		if constexpr (enabled)
+			bytesRead += bytes;
+	}
+
+	void addCorner (bool inserted) {
+		if constexpr (enabled) {
+			corners++;
+			uniqueVertexes += inserted;
+		}
+	}
+
+	/// counts of a part of the file that was prescanned instead of parsed line
+	/// by line, the prescan doesn't tell the mtl lines from the other ones
+	void addCounts (const ObjPrescan::Counts& counts, size_t usemtls = 0, size_t mtllibs = 0) {
+		if constexpr (enabled) {
+			positionLines += counts.positions;
+			normalLines += counts.normals;
+			texCoordLines += counts.texCoords;
+			faceLines += counts.faces;
+			usemtlLines += usemtls;
+			mtllibLines += mtllibs;
+			otherLines += counts.lines - counts.positions - counts.normals - counts.texCoords -
+					counts.faces - usemtls - mtllibs;
+		}
+	}
+
+	void notePeaks (size_t positions, size_t normals, size_t texCoords, size_t faces,
+			size_t vertexes, size_t indexMapSlots)
+	{
+		if constexpr (enabled) {
+			peakPositions = std::max(peakPositions, positions);
+			peakNormals = std::max(peakNormals, normals);
+			peakTexCoords = std::max(peakTexCoords, texCoords);
+			peakFaces = std::max(peakFaces, faces);
+			peakVertexes = std::max(peakVertexes, vertexes);
+			peakIndexMapSlots = std::max(peakIndexMapSlots, indexMapSlots);
+		}
+	}
+
+	friend std::ostream& operator << (std::ostream& stream, const LoadStats& stats) {
+		const char *names[PHASE_COUNT] = {
+			"other", "read", "tokenize", "dedup", "assembly", "mtl", "texture"
+		};
+
+		stream << "bytes read: " << stats.bytesRead << std::endl;
+		stream << "lines: v " << stats.positionLines << ", vn " << stats.normalLines
+				<< ", vt " << stats.texCoordLines << ", f " << stats.faceLines
+				<< ", usemtl " << stats.usemtlLines << ", mtllib " << stats.mtllibLines
+				<< ", other " << stats.otherLines << std::endl;
+		stream << "corners: " << stats.corners << ", unique " << stats.uniqueVertexes
+				<< ", dedup hit rate " << stats.dedupHitRate() << std::endl;
+
+		stream << "time: " << stats.totalTime << "s";
+		for (int i = 0; i < PHASE_COUNT; i++)
+			stream << ", " << names[i] << " " << stats.phaseTime[i] << "s";
+		stream << std::endl;
+
+		stream << "peak sizes: positions " << stats.peakPositions << ", normals "
+				<< stats.peakNormals << ", texCoords " << stats.peakTexCoords << ", faces "
+				<< stats.peakFaces << ", vertexes " << stats.peakVertexes << ", map slots "
+				<< stats.peakIndexMapSlots << std::endl;
+
+		return stream;
+	}
+
+	/// running state of the phases
+	std::chrono::steady_clock::time_point startTime;
+	uint64_t startTick = 0;
+	uint64_t lastTick = 0;
+	uint64_t phaseTicks[PHASE_COUNT] = {};
+	int currentPhase = OTHER;
+};
+
+#endif
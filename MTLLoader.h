@@ -2,7 +2,14 @@
 #define MTLLOADER_H_INCLUDED
 
 #include <map>
+#include <string_view>
 #include "TextureLoader.h"
+#include "TextureCache.h"
+#include "CompressedFile.h"
+#include "MappedFile.h"
+#include "TextParse.h"
+#include "NameIndexMap.h"
+#include "LoadStats.h"
 
 class Material {
 public:
@@ -20,239 +27,308 @@ public:
 	Texture transparencyTexture;
 	Texture bumpMapTexture; 
 	Texture dislpacementTexture;
+
+	/// files the textures above were loaded from, empty if there is no map
+	std::string ambientTexturePath;
+	std::string difuseTexturePath;
+	std::string specularTexturePath;
+	std::string highlightTexturePath;
+	std::string transparencyTexturePath;
+	std::string bumpMapTexturePath;
+	std::string dislpacementTexturePath;
+
+	/// decodes of the textures above running on the TextureCache workers,
+	/// MTLLoader::loadTextures uploads them and clears this
+	std::vector <std::shared_future<DecodedImage>> pendingTextures;
+};
+
+/// what drawing a material needs, without strings or textures to copy: the
+/// meshes keep them in a flat table (see Mesh::renderMaterials) and the
+/// drawers only take references in it
+struct MaterialRenderData {
+	/// texture slots, in the order of MTLLoader::forEachTexture
+	static const int AMBIENT = 0;
+	static const int DIFUSE = 1;
+	static const int SPECULAR = 2;
+	static const int HIGHLIGHT = 3;
+	static const int TRANSPARENCY = 4;
+	static const int BUMP_MAP = 5;
+	static const int DISPLACEMENT = 6;
+	static const int TEXTURE_COUNT = 7;
+
+	Math::Point4f ambientColor;
+	Math::Point4f difuseColor;
+	Math::Point4f specularColor;
+	float specularWeight = 0;
+
+	unsigned int textures[TEXTURE_COUNT] = {};	/// gl ids, 0 for none
+
+	/// slots (bit 1 << slot) with a path but not loaded yet, they are loaded
+	/// the first time they are asked for (see Mesh::getRenderMaterial)
+	unsigned int lazyTextures = 0;
 };
 
 class MTLLoader {
 public: 
 	std::vector<Material> materials;
-	std::map<std::string, int> materialsMap;
+	NameIndexMap materialsMap;
 
 	std::string currentDirectory;
 
-	void addMaterial (Material& material) {
+	/// only the texture paths are read, the textures are loaded later with
+	/// loadTextures, on the thread that owns the gl context
+	bool deferTextures = false;
+
+	/// texture loads are timed here if it's set
+	LoadStats *stats = nullptr;
+
+	void addMaterial (const Material& material) {
 		materials.push_back(material);
-		materialsMap[material.name] = materials.size() - 1; // we set it's code 
+		materialsMap.insert(material.name, materials.size() - 1); // we set it's code 
 	}
 
-	int getMaterialIndex (std::string name) {
-		if (materialsMap.find(name) != materialsMap.end())
-			return materialsMap[name];
-		else 
-			return -1; 
+	void addMaterial (Material&& material) {
+		materials.push_back(std::move(material));
+		materialsMap.insert(materials.back().name, materials.size() - 1);
 	}
 
-	void loadMtl (std::string directory, std::string filename) {
-		currentDirectory = directory;
-		std::string path = currentDirectory + filename; 
+	/// a new material at the end of materials, built there
+	Material& newMaterial (std::string_view name) {
+		materials.emplace_back();
+		materials.back().name = name;
+		materialsMap.insert(name, materials.size() - 1);
 
-		std::ifstream file(path.c_str()); 
+		return materials.back();
+	}
 
-		Material currentMaterial;
-		bool materialPending = false; 
+	int getMaterialIndex (std::string_view name) const {
+		return materialsMap.find(name);
+	}
 
-		std::string line; 
-		while (getline(file, line)) { 
-			std::stringstream lineStream(line);
+	/// keeps the memory for the next loadMtl
+	void clear() {
+		materials.clear();
+		materialsMap.clear();
+	}
 
-			std::string lineHeader = ""; 
-			lineStream >> lineHeader; 
+	/// the lines are read in place in the mapped file, the header is matched
+	/// on its first bytes, materials are built in materials and found by name
+	/// with a flat hash map, so only names and texture paths are allocated
+	void loadMtl (std::string directory, std::string filename) {
+		currentDirectory = directory;
+		std::string path = currentDirectory + filename; 
+		size_t firstMaterial = materials.size();
 
-			if (lineHeader == "newmtl") {
-				std::string name; 
-				lineStream >> name;
+		int current = -1;	/// index of the material being read
 
-				if (materialPending) {
-					addMaterial(currentMaterial);
-				}
+		auto parseLine = [&] (const char *begin, const char *end) {
+			TextCursor line(begin, end);
+			std::string_view header = line.nextToken();
 
-				currentMaterial.name = name; 
-				materialPending = true; 
-			}
-			else if (lineHeader == "Ka") {
-				colorAmbientParse(currentMaterial, lineStream); 
+			if (header == "newmtl") {
+				newMaterial(line.nextToken());
+				current = materials.size() - 1;
+				return;
 			}
-			else if (lineHeader == "Kd") {
-				colorDifuseParse(currentMaterial, lineStream);
-			}
-			else if (lineHeader == "Ks") {
-				colorSpecularParse(currentMaterial, lineStream);
-			}
-			else if (lineHeader == "Tr") {
-				transparencyParse(currentMaterial, lineStream);
-			}
-			else if (lineHeader == "d") {
-				dissolvedParse(currentMaterial, lineStream);
-			}
-			else if (lineHeader == "map_Ka") {
-				textureAmbientParse(currentMaterial, lineStream);
-			}
-			else if (lineHeader == "map_Kd") {
-				textureDifuseParse(currentMaterial, lineStream);
-			}
-			else if (lineHeader == "map_Ks") {
-				textureSpecularParse(currentMaterial, lineStream);
-			}
-			else if (lineHeader == "map_Ns") {
-				textureHighlinghtParse(currentMaterial, lineStream);
-			}
-			else if (lineHeader == "map_d") {
-				textureTransparencyParse(currentMaterial, lineStream);
-			}
-			else if (lineHeader == "map_bump") {
-				textureBumpMapParse(currentMaterial, lineStream);
-			}
-			else if (lineHeader == "bump") {
-				textureBumpMapParse(currentMaterial, lineStream);
-			}
-			else if (lineHeader == "disp") {
-				textureDisplacementParse(currentMaterial, lineStream);
+
+			if (current < 0 || header.size() < 1)
+				return;
+
+			Material& material = materials[current];
+
+			switch (header[0]) {
+				case 'K':
+					if (header == "Ka")
+						colorParse(material.ambientColor, line);
+					else if (header == "Kd")
+						colorParse(material.difuseColor, line);
+					else if (header == "Ks")
+						colorParse(material.specularColor, line);
+					break;
+
+				case 'T':
+					if (header == "Tr")
+						transparencyParse(material, line);
+					break;
+
+				case 'd':
+					if (header == "d")
+						dissolvedParse(material, line);
+					else if (header == "disp")
+						textureParse(material, material.dislpacementTexturePath, line);
+					break;
+
+				case 'b':
+					if (header == "bump")
+						textureParse(material, material.bumpMapTexturePath, line);
+					break;
+
+				case 'm':
+					if (header.size() < 5 || header.substr(0, 4) != "map_")
+						break;
+
+					if (header == "map_Ka")
+						textureParse(material, material.ambientTexturePath, line);
+					else if (header == "map_Kd")
+						textureParse(material, material.difuseTexturePath, line);
+					else if (header == "map_Ks")
+						textureParse(material, material.specularTexturePath, line);
+					else if (header == "map_Ns")
+						textureParse(material, material.highlightTexturePath, line);
+					else if (header == "map_d")
+						textureParse(material, material.transparencyTexturePath, line);
+					else if (header == "map_bump")
+						textureParse(material, material.bumpMapTexturePath, line);
+					break;
 			}
-		}
+		};
 
-		if (materialPending) {
-			addMaterial(currentMaterial);
+		if (CompressedFile::isCompressed(path)) {
+			CompressedFile::forEachLine(path, parseLine);
+		}
+		else {
+			MappedFile file;
+			if (file.open(path))
+				forEachLine(file.begin(), file.end(), parseLine);
 		}
 
-		file.close(); 
+		/// the workers read the texture files while this one was parsed, they
+		/// are decoded here unless TextureCache::decoder is set
+		if (!deferTextures) {
+			LoadStats::Scope scope(stats, LoadStats::TEXTURE);
+
+			for (size_t i = firstMaterial; i < materials.size(); i++)
+				loadTextures(materials[i]);
+		}
 	}
 
-	void colorAmbientParse (Material& material, std::stringstream& stream) {
-		Math::Point3f color; 
+	/// starts reading the texture on the TextureCache workers, loadMtl
+	/// uploads it at the end of the file
+	void loadTexture (Material& material, const std::string& path) {
+		LoadStats::Scope scope(stats, LoadStats::TEXTURE);
 
-		if (stream >> color)
-			material.ambientColor = color; 
+		if (!deferTextures)
+			decodeTexture(material, path);
 	}
 
-	void colorDifuseParse (Material& material, std::stringstream& stream) {
-		Math::Point3f color; 
-		
-		if (stream >> color)
-			material.difuseColor = color; 
+	static void decodeTexture (Material& material, const std::string& path) {
+		std::shared_future<DecodedImage> future = TextureCache::shared().decode(path);
+		if (future.valid())
+			material.pendingTextures.push_back(future);
 	}
 
-	void colorSpecularParse (Material& material, std::stringstream& stream) {
-		Math::Point3f color; 
-		
-		if (stream >> color)
-			material.specularColor = color; 
+	/// calls func(texture, path) for each texture of the material
+	template <typename MaterialType, typename FuncType>
+	static void forEachTexture (MaterialType& material, FuncType&& func) {
+		func(material.ambientTexture, material.ambientTexturePath);
+		func(material.difuseTexture, material.difuseTexturePath);
+		func(material.specularTexture, material.specularTexturePath);
+		func(material.highlightTexture, material.highlightTexturePath);
+		func(material.transparencyTexture, material.transparencyTexturePath);
+		func(material.bumpMapTexture, material.bumpMapTexturePath);
+		func(material.dislpacementTexture, material.dislpacementTexturePath);
 	}
 
-	void specularWeightParse (Material& material, std::stringstream& stream) {
-		float specularWeight; 
-
-		if (stream >> specularWeight)
-			material.specularWeight = specularWeight;
+	/// loads every texture that has a path, for materials read with
+	/// deferTextures or from a MeshCache; what decodeTextures started is
+	/// only uploaded
+	static void loadTextures (std::vector<Material>& materials) {
+		for (auto&& material : materials)
+			loadTextures(material);
 	}
 
-	void transparencyParse (Material& material, std::stringstream& stream) {
-		float transparency; 
-		stream >> transparency;
+	static void loadTextures (Material& material) {
+		forEachTexture(material, [] (Texture& texture, const std::string& path) {
+			if (path != "")
+				texture = TextureCache::shared().acquire(path);
+		});
 
-		if (stream >> transparency)
-			material.ambientColor.a = material.difuseColor.a = material.specularColor.a =
-										transparency;  
+		material.pendingTextures.clear();
 	}
 
-	void dissolvedParse (Material& material, std::stringstream& stream) {
-		float disolved; 
-		stream >> disolved;
-
-		if (stream >> disolved)
-			material.ambientColor.a = material.difuseColor.a = material.specularColor.a =
-										(1.0 - disolved);  
+	/// starts reading the textures on the TextureCache workers, call it from
+	/// any thread once the materials are read so loadTextures has less to do
+	static void decodeTextures (std::vector<Material>& materials) {
+		for (auto&& material : materials) {
+			forEachTexture(material, [&] (Texture& texture, const std::string& path) {
+				if (path != "")
+					decodeTexture(material, path);
+			});
+		}
 	}
 
-	/// not parsing options of the textures
-
-	void textureAmbientParse (Material& material, std::stringstream& stream) {
-		std::string name; 
-		stream >> name;
-
-		while (name.size() >= 1 && name[0] == '-')
-			stream >> name; 
-
-		std::string path = currentDirectory + name; 
-
-		if (name != "")
-			material.ambientTexture = TextureLoader::load(path); 
+	/// gives back to the TextureCache the textures the materials loaded, the
+	/// last material using an image deletes it; Mesh calls it when it's
+	/// destroyed, textures that failed to load hold no reference
+	static void releaseTextures (std::vector<Material>& materials) {
+		for (auto&& material : materials) {
+			forEachTexture(material, [] (Texture& texture, const std::string& path) {
+				if (path != "" && texture.openglTexture != 0) {
+					TextureCache::shared().release(path);
+					texture = Texture();
+				}
+			});
+		}
 	}
 
-	void textureDifuseParse (Material& material, std::stringstream& stream) {
-		std::string name; 
-		stream >> name;
-
-		while (name.size() >= 1 && name[0] == '-')
-			stream >> name; 
-
-		std::string path = currentDirectory + name;
-
-		if (name != "")
-			material.difuseTexture = TextureLoader::load(path);
+	/// one more reference on each texture the materials loaded, for a copy
+	/// of them that is released on its own
+	static void retainTextures (std::vector<Material>& materials) {
+		for (auto&& material : materials) {
+			forEachTexture(material, [] (Texture& texture, const std::string& path) {
+				if (path != "" && texture.openglTexture != 0)
+					TextureCache::shared().retain(path);
+			});
+		}
 	}
 
-	void textureSpecularParse (Material& material, std::stringstream& stream) {
-		std::string name; 
-		stream >> name;
-
-		while (name.size() >= 1 && name[0] == '-')
-			stream >> name; 
+	/// r g b, the alpha is left alone
+	static void colorParse (Math::Point4f& color, TextCursor& line) {
+		float r, g, b;
 
-		std::string path = currentDirectory + name;
-
-		if (name != "")
-			material.specularTexture = TextureLoader::load(path);
+		if (line.nextFloat(r) && line.nextFloat(g) && line.nextFloat(b))
+			color = Math::Point3f(r, g, b);
 	}
 
-	void textureHighlinghtParse (Material& material, std::stringstream& stream) {
-		std::string name; 
-		stream >> name;
-
-		while (name.size() >= 1 && name[0] == '-')
-			stream >> name; 
-
-		std::string path = currentDirectory + name;
+	void specularWeightParse (Material& material, TextCursor& line) {
+		float specularWeight; 
 
-		if (name != "")
-			material.highlightTexture = TextureLoader::load(path);
+		if (line.nextFloat(specularWeight))
+			material.specularWeight = specularWeight;
 	}
 
-	void textureTransparencyParse (Material& material, std::stringstream& stream) {
-		std::string name; 
-		stream >> name;
-
-		while (name.size() >= 1 && name[0] == '-')
-			stream >> name; 
-
-		std::string path = currentDirectory + name;
+	void transparencyParse (Material& material, TextCursor& line) {
+		float transparency; 
+		line.nextFloat(transparency);
 
-		if (name != "")
-			material.transparencyTexture = TextureLoader::load(path);
+		if (line.nextFloat(transparency))
+			material.ambientColor.a = material.difuseColor.a = material.specularColor.a =
+										transparency;  
 	}
 
-	void textureBumpMapParse (Material& material, std::stringstream& stream) {
-		std::string name; 
-		stream >> name;
-
-		while (name.size() >= 1 && name[0] == '-')
-			stream >> name; 
-		
-		std::string path = currentDirectory + name;
+	void dissolvedParse (Material& material, TextCursor& line) {
+		float disolved; 
+		line.nextFloat(disolved);
 
-		if (name != "")
-			material.bumpMapTexture = TextureLoader::load(path);
+		if (line.nextFloat(disolved))
+			material.ambientColor.a = material.difuseColor.a = material.specularColor.a =
+										(1.0 - disolved);  
 	}
 
-	void textureDisplacementParse (Material& material, std::stringstream& stream) {
-		std::string name; 
-		stream >> name;
+	/// not parsing options of the textures
+	void textureParse (Material& material, std::string& texturePath, TextCursor& line) {
+		std::string_view name = line.nextToken();
 
 		while (name.size() >= 1 && name[0] == '-')
-			stream >> name; 
-		
-		std::string path = currentDirectory + name;
+			name = line.nextToken();
 
-		if (name != "")
-			material.dislpacementTexture = TextureLoader::load(path);
+		if (name != "") {
+			std::string path = currentDirectory;
+			path += name;
+
+			loadTexture(material, path);
+			texturePath = std::move(path);
+		}
 	}
 };
 
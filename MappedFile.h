@@ -0,0 +1,145 @@
+#ifndef MAPPED_FILE_H_INCLUDED
+#define MAPPED_FILE_H_INCLUDED
+
+#include <string>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+/// read only view of a whole file, the bytes are not null terminated
+class MappedFile {
+public:
+	const char *data = nullptr;
+	size_t size = 0;
+
+	MappedFile() {}
+
+	MappedFile (std::string path) {
+		if (!open(path))
+			throw std::runtime_error("can't map file: " + path);
+	}
+
+	MappedFile (const MappedFile& other) = delete;
+	MappedFile& operator = (const MappedFile& other) = delete;
+
+	MappedFile (MappedFile&& other) {
+		movOp(other);
+	}
+
+	MappedFile& operator = (MappedFile&& other) {
+		close();
+		return movOp(other);
+	}
+
+	MappedFile& movOp (MappedFile& other) {
+		data = other.data;
+		size = other.size;
+		other.data = nullptr;
+		other.size = 0;
+
+		return *this;
+	}
+
+	bool open (std::string path) {
+		close();
+
+#ifdef _WIN32
+		HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+				OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+		if (file == INVALID_HANDLE_VALUE)
+			return false;
+
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(file, &fileSize)) {
+			CloseHandle(file);
+			return false;
+		}
+
+		size = fileSize.QuadPart;
+
+		/// an empty file can't be mapped, but it is still a valid file
+		if (size == 0) {
+			CloseHandle(file);
+			return true;
+		}
+
+		HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		CloseHandle(file);
+
+		if (mapping == NULL)
+			return false;
+
+		data = (const char *)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		CloseHandle(mapping);
+
+		if (data == nullptr) {
+			size = 0;
+			return false;
+		}
+#else
+		int fd = ::open(path.c_str(), O_RDONLY);
+		if (fd < 0)
+			return false;
+
+		struct stat fileStat;
+		if (fstat(fd, &fileStat) < 0) {
+			::close(fd);
+			return false;
+		}
+
+		size = fileStat.st_size;
+
+		/// an empty file can't be mapped, but it is still a valid file
+		if (size == 0) {
+			::close(fd);
+			return true;
+		}
+
+		void *addr = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+		::close(fd);
+
+		if (addr == MAP_FAILED) {
+			size = 0;
+			return false;
+		}
+
+		madvise(addr, size, MADV_SEQUENTIAL);
+		data = (const char *)addr;
+#endif
+		return true;
+	}
+
+	void close() {
+		if (data != nullptr) {
+#ifdef _WIN32
+			UnmapViewOfFile(data);
+#else
+			munmap((void *)data, size);
+#endif
+		}
+
+		data = nullptr;
+		size = 0;
+	}
+
+	const char *begin() const {
+		return data;
+	}
+
+	const char *end() const {
+		return data + size;
+	}
+
+	~MappedFile() {
+		close();
+	}
+};
+
+#endif
@@ -3,6 +3,7 @@
 
 #include "Vertex.h"
 #include "MTLLoader.h"
+#include "FaceList.h"
 
 template <typename VertexType>
 class Mesh {
@@ -12,17 +13,221 @@ public:
 	std::vector <VertexType> vertexList; 
 	std::vector <Material> materials;
 	std::vector <int> materialIndex;
-	std::vector <std::vector<int>> elementIndex;
+	FaceList elementIndex;
+
+	/// faces triangulated on load (see OBJLoader::triangulate), 3 indexes per
+	/// triangle, ready for GL_TRIANGLES; elementIndex then only keeps the
+	/// points and lines
+	std::vector <int> triangleIndex;
+	std::vector <int> triangleMaterialIndex;	/// one per triangle
+
+	/// after groupByMaterial, the faces and triangles of one material
+	struct SubMesh {
+		int material;	/// -1 for faces without a valid material
+		int faceBegin;
+		int faceCount;
+		int triangleBegin;	/// in triangles, not in indexes
+		int triangleCount;
+	};
+	std::vector <SubMesh> subMeshes;
+
+	/// materials[i] as the drawers use it, see updateRenderMaterials
+	std::vector <MaterialRenderData> renderMaterials;
 
 	Mesh() {
 		materialIndex.push_back(0);
 	}
 
-	Material getMaterialByIndex (int index) {
+	/// each mesh holds a TextureCache reference on every texture its
+	/// materials loaded, a copy takes its own and they are released with
+	/// the mesh, so destroy meshes with textures on the gl thread
+	Mesh (const Mesh& other) :
+		vertexList(other.vertexList), materials(other.materials),
+		materialIndex(other.materialIndex), elementIndex(other.elementIndex),
+		triangleIndex(other.triangleIndex), triangleMaterialIndex(other.triangleMaterialIndex),
+		subMeshes(other.subMeshes), renderMaterials(other.renderMaterials)
+	{
+		MTLLoader::retainTextures(materials);
+	}
+
+	Mesh (Mesh&& other) = default;
+
+	Mesh& operator = (const Mesh& other) {
+		return *this = Mesh(other);
+	}
+
+	Mesh& operator = (Mesh&& other) {
+		if (this == &other)
+			return *this;
+
+		MTLLoader::releaseTextures(materials);
+
+		vertexList = std::move(other.vertexList);
+		materials = std::move(other.materials);
+		materialIndex = std::move(other.materialIndex);
+		elementIndex = std::move(other.elementIndex);
+		triangleIndex = std::move(other.triangleIndex);
+		triangleMaterialIndex = std::move(other.triangleMaterialIndex);
+		subMeshes = std::move(other.subMeshes);
+		renderMaterials = std::move(other.renderMaterials);
+
+		other.materials.clear();
+		return *this;
+	}
+
+	~Mesh() {
+		MTLLoader::releaseTextures(materials);
+	}
+
+	const Material& getMaterialByIndex (int index) const {
+		static const Material none;
+
 		if (index >= 0 && index < materials.size())
 			return materials[index];
 		else
-			return Material();
+			return none;
+	}
+
+	/// the handle of a material is its index, invalid ones get the default
+	const MaterialRenderData& getRenderMaterial (int index) const {
+		static const MaterialRenderData none;
+
+		if (index >= 0 && index < renderMaterials.size())
+			return renderMaterials[index];
+		else
+			return none;
+	}
+
+	/// the same, with the lazy textures of slots (bits 1 << slot) loaded
+	/// first, so call it on the gl thread
+	const MaterialRenderData& getRenderMaterial (int index, unsigned int slots) {
+		if (index >= 0 && index < renderMaterials.size() &&
+				(renderMaterials[index].lazyTextures & slots))
+			loadLazyTextures(index, slots);
+
+		return getRenderMaterial(index);
+	}
+
+	void loadLazyTextures (int index, unsigned int slots) {
+		MaterialRenderData& data = renderMaterials[index];
+		unsigned int load = data.lazyTextures & slots;
+
+		int slot = 0;
+		MTLLoader::forEachTexture(materials[index], [&] (Texture& texture, const std::string& path) {
+			if (load & (1u << slot)) {
+				texture = TextureCache::shared().acquire(path);
+				data.textures[slot] = texture.openglTexture;
+			}
+			slot++;
+		});
+
+		data.lazyTextures &= ~load;
+	}
+
+	/// hint that a material will be drawn soon: its lazy textures start
+	/// loading on the TextureCache workers (see TextureCache::decoder), from
+	/// any thread
+	void prefetchTextures (int index, unsigned int slots = ~0u) const {
+		if (index < 0 || index >= renderMaterials.size())
+			return;
+
+		unsigned int prefetch = renderMaterials[index].lazyTextures & slots;
+
+		int slot = 0;
+		MTLLoader::forEachTexture(materials[index], [&] (const Texture& texture, const std::string& path) {
+			if (prefetch & (1u << slot))
+				TextureCache::shared().decode(path);
+			slot++;
+		});
+	}
+
+	/// rebuilds renderMaterials, call it when materials or their textures change
+	void updateRenderMaterials() {
+		renderMaterials.resize(materials.size());
+
+		for (int i = 0; i < materials.size(); i++) {
+			const Material& material = materials[i];
+			MaterialRenderData& data = renderMaterials[i];
+
+			data.ambientColor = material.ambientColor;
+			data.difuseColor = material.difuseColor;
+			data.specularColor = material.specularColor;
+			data.specularWeight = material.specularWeight;
+
+			data.lazyTextures = 0;
+
+			int slot = 0;
+			MTLLoader::forEachTexture(material, [&] (const Texture& texture, const std::string& path) {
+				data.textures[slot] = texture.openglTexture;
+				if (path != "" && texture.openglTexture == 0)
+					data.lazyTextures |= 1u << slot;
+				slot++;
+			});
+		}
+	}
+
+	/// stable counting sort of the faces and of the triangles by material, so
+	/// every material can be drawn with one call; fills subMeshes in
+	/// material order, faces without a valid material go first
+	void groupByMaterial() {
+		int bucketCount = materials.size() + 1;
+		auto bucket = [&] (const std::vector<int>& materialOf, int i) {
+			int material = i < materialOf.size() ? materialOf[i] : -1;
+			return material >= 0 && material < materials.size() ? material + 1 : 0;
+		};
+
+		std::vector <int> faceStart(bucketCount + 1, 0);
+		for (int i = 0; i < elementIndex.size(); i++)
+			faceStart[bucket(materialIndex, i) + 1]++;
+
+		std::vector <int> triangleStart(bucketCount + 1, 0);
+		for (int i = 0; i < triangleIndex.size() / 3; i++)
+			triangleStart[bucket(triangleMaterialIndex, i) + 1]++;
+
+		for (int i = 0; i < bucketCount; i++) {
+			faceStart[i + 1] += faceStart[i];
+			triangleStart[i + 1] += triangleStart[i];
+		}
+
+		/// the faces have different sizes, so their order is sorted first and
+		/// they are copied in it
+		std::vector <int> faceOrder(elementIndex.size());
+		std::vector <int> sortedFaceMaterials(elementIndex.size());
+		std::vector <int> next(faceStart.begin(), faceStart.end() - 1);
+		for (int i = 0; i < elementIndex.size(); i++) {
+			int pos = next[bucket(materialIndex, i)]++;
+			faceOrder[pos] = i;
+			sortedFaceMaterials[pos] = i < materialIndex.size() ? materialIndex[i] : -1;
+		}
+
+		FaceList sortedFaces;
+		sortedFaces.reserve(elementIndex.size(), elementIndex.cornerCount());
+		for (int i : faceOrder)
+			sortedFaces.push_back(elementIndex[i]);
+
+		std::vector <int> sortedTriangles(triangleIndex.size() / 3 * 3);
+		std::vector <int> sortedTriangleMaterials(triangleIndex.size() / 3);
+		next.assign(triangleStart.begin(), triangleStart.end() - 1);
+		for (int i = 0; i < triangleIndex.size() / 3; i++) {
+			int pos = next[bucket(triangleMaterialIndex, i)]++;
+			std::copy(&triangleIndex[i * 3], &triangleIndex[i * 3] + 3, &sortedTriangles[pos * 3]);
+			sortedTriangleMaterials[pos] = i < triangleMaterialIndex.size() ?
+					triangleMaterialIndex[i] : -1;
+		}
+
+		elementIndex = std::move(sortedFaces);
+		materialIndex = std::move(sortedFaceMaterials);
+		triangleIndex = std::move(sortedTriangles);
+		triangleMaterialIndex = std::move(sortedTriangleMaterials);
+
+		subMeshes.clear();
+		for (int i = 0; i < bucketCount; i++) {
+			int faceCount = faceStart[i + 1] - faceStart[i];
+			int triangleCount = triangleStart[i + 1] - triangleStart[i];
+
+			if (faceCount || triangleCount)
+				subMeshes.push_back({i - 1, faceStart[i], faceCount, triangleStart[i], triangleCount});
+		}
 	}
 
 	int getVertCount() {
@@ -44,6 +249,11 @@ public:
 			stream << std::endl;
 		}
 
+		for (int i = 0; i + 2 < arg.triangleIndex.size(); i += 3) {
+			stream << arg.triangleIndex[i] << " " << arg.triangleIndex[i + 1] << " "
+					<< arg.triangleIndex[i + 2] << " " << std::endl;
+		}
+
 		return stream;
 	}
 };
@@ -0,0 +1,82 @@
+#ifndef MESH_BATCH_LOADER_H_INCLUDED
+#define MESH_BATCH_LOADER_H_INCLUDED
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <exception>
+
+#include "OBJLoader.h"
+#include "MtlLibrary.h"
+
+/// loads many obj files at once on threadCount threads, with the options
+/// of settings; the mtl files they share are parsed once and the textures
+/// are read ahead on the workers of the TextureCache and uploaded on the
+/// calling thread, so call it on the thread that owns the gl context
+///
+/// mtlLibrary is kept between calls, the next batches reuse what it has
+template <typename VertexType>
+class MeshBatchLoader {
+public:
+	OBJLoader<VertexType> settings;
+	MtlLibrary mtlLibrary;
+
+	int threadCount = 0;	/// 0 means one thread per core
+
+	/// meshes[i] is the mesh of paths[i], the mtl files are looked for next
+	/// to their obj; if some files fail, the first error is thrown once the
+	/// others are done
+	std::vector <Mesh<VertexType>> load (const std::vector<std::string>& paths) {
+		std::vector <Mesh<VertexType>> meshes(paths.size());
+		std::vector <std::exception_ptr> errors(paths.size());
+
+		std::atomic<size_t> next(0);
+		auto work = [&] () {
+			for (size_t i = next++; i < paths.size(); i = next++) {
+				try {
+					size_t slash = paths[i].find_last_of("/\\");
+					std::string directory = slash == std::string::npos ? "" :
+							paths[i].substr(0, slash + 1);
+
+					OBJLoader<VertexType> loader;
+					loader.copySettings(settings);
+					loader.mtlLibrary = &mtlLibrary;
+
+					meshes[i] = std::move(loader).loadMesh(directory,
+							paths[i].substr(directory.size()));
+					if (!settings.lazyTextures)
+						MTLLoader::decodeTextures(meshes[i].materials);
+				}
+				catch (...) {
+					errors[i] = std::current_exception();
+				}
+			}
+		};
+
+		int workers = threadCount > 0 ? threadCount : std::thread::hardware_concurrency();
+		workers = std::max(workers, 1);
+
+		std::vector <std::thread> threads;
+		for (int i = 1; i < std::min<size_t>(workers, paths.size()); i++)
+			threads.emplace_back(work);
+		work();
+
+		for (auto&& thread : threads)
+			thread.join();
+
+		for (auto&& error : errors)
+			if (error)
+				std::rethrow_exception(error);
+
+		for (auto&& mesh : meshes) {
+			if (!settings.lazyTextures)
+				mtlLibrary.loadTextures(mesh.materials);
+			mesh.updateRenderMaterials();
+		}
+
+		return meshes;
+	}
+};
+
+#endif
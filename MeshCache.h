@@ -0,0 +1,294 @@
+#ifndef MESH_CACHE_H_INCLUDED
+#define MESH_CACHE_H_INCLUDED
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <typeinfo>
+#include <type_traits>
+#include <sys/stat.h>
+
+#include "Mesh.h"
+#include "MappedFile.h"
+#include "BinaryFile.h"
+
+/// binary image of a Mesh (.meshbin), written after an obj is parsed and read
+/// back instead of parsing it again; the cache is only used if the source
+/// file and every mtl it loaded still have the same size and mtime and the
+/// vertex layout is the same, textures are loaded again from their paths
+///
+/// layout (native endianess, no padding):
+///		header: magic, version, layout, load options, source stamp, dependency stamps
+///		vertexes: count, raw bytes of vertexList
+///		faces: count, sizes, count, corners of all the faces (FaceList::indexes)
+///		materialIndex: count, ints
+///		triangles: count, triangleIndex, count, triangleMaterialIndex
+///		subMeshes: count, 5 ints each
+///		materials: count, {name, colors, weight, texture paths}
+class MeshCache {
+public:
+	static const uint32_t MAGIC = 0x4e42534d;	/// "MSBN"
+	static const uint32_t VERSION = 3;
+
+	/// size of a dependency that doesn't exist, the cache stays valid as long
+	/// as it is still missing
+	static const uint64_t ABSENT = ~0ull;
+
+	struct FileStamp {
+		std::string path;
+		uint64_t size = 0;
+		int64_t mtime = 0;
+	};
+
+	static std::string cachePath (std::string sourcePath) {
+		return sourcePath + ".meshbin";
+	}
+
+	static bool stampFile (std::string path, FileStamp& stamp) {
+		struct stat fileStat;
+		if (stat(path.c_str(), &fileStat) != 0)
+			return false;
+
+		stamp.path = path;
+		stamp.size = fileStat.st_size;
+#if defined(__linux__)
+		stamp.mtime = (int64_t)fileStat.st_mtim.tv_sec * 1000000000 + fileStat.st_mtim.tv_nsec;
+#else
+		stamp.mtime = fileStat.st_mtime;
+#endif
+		return true;
+	}
+
+	/// a missing file is stamped ABSENT instead of failing
+	static void stampDependency (std::string path, FileStamp& stamp) {
+		if (!stampFile(path, stamp)) {
+			stamp.path = path;
+			stamp.size = ABSENT;
+			stamp.mtime = 0;
+		}
+	}
+
+	/// changes if the size, order or type of any vertex component changes
+	template <typename VertexType>
+	static uint64_t layoutHash() {
+		uint64_t hash = 1469598103934665603ull;
+		auto mix = [&] (uint64_t value) {
+			hash = (hash ^ value) * 1099511628211ull;
+		};
+		auto mixStr = [&] (const char *str) {
+			for (; *str; str++)
+				mix(*str);
+		};
+
+		mix(sizeof(VertexType));
+		mix(VertexType::nodeCount);
+		mix(sizeof(Math::Point4f));
+
+		VertexType vertex;
+		const char *base = (const char *)&vertex;
+		vertex.mapFunc([&] (auto& node) {
+			using NodeType = typename std::remove_reference<decltype(node)>::type;
+
+			mix((const char *)&node.data - base);
+			mix(sizeof(node.data));
+			mixStr(typeid(typename NodeType::DataType).name());
+			mixStr(typeid(typename NodeType::DescType).name());
+		});
+
+		return hash;
+	}
+
+	/// options are the loader settings that change the mesh, a cache is
+	/// only read back with the same ones
+	template <typename VertexType>
+	static bool write (std::string sourcePath, const std::vector<std::string>& dependencies,
+			const Mesh<VertexType>& mesh, uint64_t options = 0)
+	{
+		if constexpr (!std::is_trivially_copyable<VertexType>::value)
+			return false;
+
+		FileStamp source;
+		if (!stampFile(sourcePath, source))
+			return false;
+
+		std::vector <FileStamp> stamps(dependencies.size());
+		for (int i = 0; i < dependencies.size(); i++)
+			stampDependency(dependencies[i], stamps[i]);
+
+		BinaryWriter file;
+		if (!file.open(cachePath(sourcePath)))
+			return false;
+
+		auto putStamp = [&] (const FileStamp& stamp) {
+			file.putStr(stamp.path);
+			file.putU64(stamp.size);
+			file.putU64(stamp.mtime);
+		};
+
+		file.putU64(MAGIC);
+		file.putU64(VERSION);
+		file.putU64(layoutHash<VertexType>());
+		file.putU64(options);
+		putStamp(source);
+		file.putU64(stamps.size());
+		for (auto&& stamp : stamps)
+			putStamp(stamp);
+
+		file.putU64(mesh.vertexList.size());
+		file.put(mesh.vertexList.data(), mesh.vertexList.size() * sizeof(VertexType));
+
+		const FaceList& faces = mesh.elementIndex;
+		file.putU64(faces.size());
+		for (size_t i = 0; i < faces.size(); i++) {
+			int32_t faceSize = faces.offsets[i + 1] - faces.offsets[i];
+			file.put(&faceSize, sizeof(faceSize));
+		}
+
+		file.putU64(faces.cornerCount());
+		file.put(faces.indexes.data(), faces.cornerCount() * sizeof(int32_t));
+
+		file.putU64(mesh.materialIndex.size());
+		file.put(mesh.materialIndex.data(), mesh.materialIndex.size() * sizeof(int32_t));
+
+		file.putU64(mesh.triangleIndex.size());
+		file.put(mesh.triangleIndex.data(), mesh.triangleIndex.size() * sizeof(int32_t));
+
+		file.putU64(mesh.triangleMaterialIndex.size());
+		file.put(mesh.triangleMaterialIndex.data(),
+				mesh.triangleMaterialIndex.size() * sizeof(int32_t));
+
+		static_assert(sizeof(typename Mesh<VertexType>::SubMesh) == 5 * sizeof(int32_t));
+		file.putU64(mesh.subMeshes.size());
+		file.put(mesh.subMeshes.data(), mesh.subMeshes.size() * sizeof(mesh.subMeshes[0]));
+
+		file.putU64(mesh.materials.size());
+		for (auto&& material : mesh.materials) {
+			file.putStr(material.name);
+			file.put(&material.ambientColor, sizeof(Math::Point4f));
+			file.put(&material.difuseColor, sizeof(Math::Point4f));
+			file.put(&material.specularColor, sizeof(Math::Point4f));
+			file.put(&material.specularWeight, sizeof(float));
+			file.putStr(material.ambientTexturePath);
+			file.putStr(material.difuseTexturePath);
+			file.putStr(material.specularTexturePath);
+			file.putStr(material.highlightTexturePath);
+			file.putStr(material.transparencyTexturePath);
+			file.putStr(material.bumpMapTexturePath);
+			file.putStr(material.dislpacementTexturePath);
+		}
+
+		return file.commit();
+	}
+
+	/// false if there is no valid cache for the source, mesh is then untouched;
+	/// without loadTextures only the texture paths are set
+	template <typename VertexType>
+	static bool read (std::string sourcePath, Mesh<VertexType>& mesh, uint64_t options = 0,
+			bool loadTextures = true)
+	{
+		if constexpr (!std::is_trivially_copyable<VertexType>::value)
+			return false;
+
+		MappedFile file;
+		if (!file.open(cachePath(sourcePath)))
+			return false;
+
+		BinaryReader reader(file.begin(), file.end());
+
+		auto checkStamp = [&] (std::string expectedPath) {
+			std::string path = reader.getStr();
+			uint64_t size = reader.getU64();
+			int64_t mtime = reader.getU64();
+
+			FileStamp stamp;
+			if (!reader.ok || (expectedPath != "" && path != expectedPath))
+				return false;
+
+			stampDependency(path, stamp);
+			return stamp.size == size && stamp.mtime == mtime;
+		};
+
+		if (reader.getU64() != MAGIC || reader.getU64() != VERSION ||
+				reader.getU64() != layoutHash<VertexType>() || reader.getU64() != options)
+			return false;
+
+		if (!checkStamp(sourcePath))
+			return false;
+
+		uint64_t dependencyCount = reader.getU64();
+		for (uint64_t i = 0; reader.ok && i < dependencyCount; i++)
+			if (!checkStamp(""))
+				return false;
+
+		Mesh<VertexType> result;
+
+		result.vertexList.resize(reader.getCount(sizeof(VertexType)));
+		reader.get(result.vertexList.data(), result.vertexList.size() * sizeof(VertexType));
+
+		std::vector <int32_t> faceSizes(reader.getCount(sizeof(int32_t)));
+		reader.get(faceSizes.data(), faceSizes.size() * sizeof(int32_t));
+
+		/// the sizes become the offsets of the faces, they must cover the indexes exactly
+		uint64_t indexCount = reader.getCount(sizeof(int32_t));
+		uint64_t usedIndices = 0;
+
+		FaceList& faces = result.elementIndex;
+		faces.offsets.reserve(faceSizes.size() + 1);
+		for (size_t i = 0; reader.ok && i < faceSizes.size(); i++) {
+			if (faceSizes[i] < 0 || indexCount - usedIndices < faceSizes[i]) {
+				reader.ok = false;
+				break;
+			}
+
+			usedIndices += faceSizes[i];
+			faces.offsets.push_back(usedIndices);
+		}
+
+		if (usedIndices != indexCount)
+			return false;
+
+		faces.indexes.resize(indexCount);
+		reader.get(faces.indexes.data(), indexCount * sizeof(int32_t));
+
+		result.materialIndex.resize(reader.getCount(sizeof(int32_t)));
+		reader.get(result.materialIndex.data(), result.materialIndex.size() * sizeof(int32_t));
+
+		result.triangleIndex.resize(reader.getCount(sizeof(int32_t)));
+		reader.get(result.triangleIndex.data(), result.triangleIndex.size() * sizeof(int32_t));
+
+		result.triangleMaterialIndex.resize(reader.getCount(sizeof(int32_t)));
+		reader.get(result.triangleMaterialIndex.data(),
+				result.triangleMaterialIndex.size() * sizeof(int32_t));
+
+		result.subMeshes.resize(reader.getCount(sizeof(result.subMeshes[0])));
+		reader.get(result.subMeshes.data(), result.subMeshes.size() * sizeof(result.subMeshes[0]));
+
+		result.materials.resize(reader.getCount(1));
+		for (auto&& material : result.materials) {
+			material.name = reader.getStr();
+			reader.get(&material.ambientColor, sizeof(Math::Point4f));
+			reader.get(&material.difuseColor, sizeof(Math::Point4f));
+			reader.get(&material.specularColor, sizeof(Math::Point4f));
+			reader.get(&material.specularWeight, sizeof(float));
+			material.ambientTexturePath = reader.getStr();
+			material.difuseTexturePath = reader.getStr();
+			material.specularTexturePath = reader.getStr();
+			material.highlightTexturePath = reader.getStr();
+			material.transparencyTexturePath = reader.getStr();
+			material.bumpMapTexturePath = reader.getStr();
+			material.dislpacementTexturePath = reader.getStr();
+		}
+
+		if (!reader.ok)
+			return false;
+
+		if (loadTextures)
+			MTLLoader::loadTextures(result.materials);
+		result.updateRenderMaterials();
+
+		mesh = std::move(result);
+		return true;
+	}
+};
+
+#endif
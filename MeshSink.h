@@ -0,0 +1,75 @@
+#ifndef MESH_SINK_H_INCLUDED
+#define MESH_SINK_H_INCLUDED
+
+#include <vector>
+
+#include "Mesh.h"
+#include "FaceList.h"
+
+/// receives a mesh in batches while it is loaded (see OBJLoader::streamMesh)
+/// vertexes always arrive before the faces that use them, face indexes count
+/// all the vertexes sent so far, the batches are reused after each call
+template <typename VertexType>
+class MeshSink {
+public:
+	virtual void addVertices (const std::vector<VertexType>& vertices) = 0;
+
+	/// materials[i] is the material index of faces[i]
+	virtual void addFaces (const FaceList& faces,
+			const std::vector<int>& materials) = 0;
+
+	/// triangles of triangulated faces, 3 indexes each, materials[i] is the
+	/// material of triangle i; by default they are sent as faces
+	virtual void addTriangles (const std::vector<int>& triangles,
+			const std::vector<int>& materials)
+	{
+		FaceList faces;
+		faces.reserve(triangles.size() / 3, triangles.size() / 3 * 3);
+		for (int i = 0; i + 2 < triangles.size(); i += 3)
+			faces.push_back(triangles.begin() + i, triangles.begin() + i + 3);
+
+		addFaces(faces, materials);
+	}
+
+	/// called once, after the last batch
+	virtual void setMaterials (const std::vector<Material>& materials) {}
+
+	virtual ~MeshSink() {}
+};
+
+/// collects the batches in a Mesh
+template <typename VertexType>
+class MeshBuilderSink : public MeshSink<VertexType> {
+public:
+	Mesh<VertexType> mesh;
+
+	MeshBuilderSink() {
+		mesh.materialIndex.clear();
+	}
+
+	virtual void addVertices (const std::vector<VertexType>& vertices) override {
+		mesh.vertexList.insert(mesh.vertexList.end(), vertices.begin(), vertices.end());
+	}
+
+	virtual void addFaces (const FaceList& faces,
+			const std::vector<int>& materials) override
+	{
+		mesh.elementIndex.append(faces);
+		mesh.materialIndex.insert(mesh.materialIndex.end(), materials.begin(), materials.end());
+	}
+
+	virtual void addTriangles (const std::vector<int>& triangles,
+			const std::vector<int>& materials) override
+	{
+		mesh.triangleIndex.insert(mesh.triangleIndex.end(), triangles.begin(), triangles.end());
+		mesh.triangleMaterialIndex.insert(mesh.triangleMaterialIndex.end(), materials.begin(),
+				materials.end());
+	}
+
+	virtual void setMaterials (const std::vector<Material>& materials) override {
+		mesh.materials = materials;
+		mesh.updateRenderMaterials();
+	}
+};
+
+#endif
@@ -32,7 +32,7 @@ namespace Util
 
 		addVert(mesh, Math::trunc<Math::Vec3f>(transf * A), color);
 
-		mesh.elementIndex.push_back(std::vector<int>{index + 0});
+		mesh.elementIndex.push_back({index + 0});
 	}
 
 	/// transf is additional transformation to the object to be added
@@ -49,7 +49,7 @@ namespace Util
 		addVert(mesh, trunc<Vec3f>(transf * Point4f(A, 1)), color);
 		addVert(mesh, trunc<Vec3f>(transf * Point4f(B, 1)), color);
 
-		mesh.elementIndex.push_back(std::vector<int>{index + 0, index + 1});
+		mesh.elementIndex.push_back({index + 0, index + 1});
 	}
 
 	template <typename VertType>
@@ -74,7 +74,7 @@ namespace Util
 		addVert(mesh, Math::trunc<Math::Vec3f>(transf * Math::Vec4f(C, 1)),
 				color, Math::trunc<Math::Vec3f>(transf * Math::Vec4f(normC)));
 	
-		mesh.elementIndex.push_back(std::vector<int>{index + 0, index + 1, index + 2});
+		mesh.elementIndex.push_back({index + 0, index + 1, index + 2});
 	}
 
 	// 2d surfaces will all be on xy, z will be perpendicular on them
@@ -111,7 +111,7 @@ namespace Util
 				Math::trunc<Math::Vec3f>(transf * Math::Vec4f(normal)),
 				Math::Vec2f(1, 0));
 
-		mesh.elementIndex.push_back(std::vector<int>{
+		mesh.elementIndex.push_back({
 				index + 0, index + 1, index + 2, index + 3});
 	}
 
@@ -0,0 +1,69 @@
+#ifndef MTL_LIBRARY_H_INCLUDED
+#define MTL_LIBRARY_H_INCLUDED
+
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <future>
+
+#include "MTLLoader.h"
+
+/// mtl files shared by many loaders (see OBJLoader::mtlLibrary and
+/// MeshBatchLoader): every mtl file is parsed once, by the first loader
+/// that asks for it while the others wait; the textures are shared by the
+/// TextureCache
+///
+/// get can be called from any thread, the mtl files are parsed with
+/// deferred textures; loadTextures must be called on the gl thread
+class MtlLibrary {
+public:
+	std::mutex mutex;
+	std::map <std::string, std::shared_future<std::vector<Material>>> files;
+
+	/// the materials of directory + filename
+	const std::vector<Material>& get (std::string directory, std::string filename) {
+		std::string path = directory + filename;
+		std::promise <std::vector<Material>> promise;
+		std::shared_future <std::vector<Material>> future;
+		bool parseHere = false;
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+
+			auto it = files.find(path);
+			if (it == files.end()) {
+				future = promise.get_future().share();
+				files[path] = future;
+				parseHere = true;
+			}
+			else {
+				future = it->second;
+			}
+		}
+
+		if (parseHere) {
+			try {
+				MTLLoader loader;
+				loader.deferTextures = true;
+				loader.loadMtl(directory, filename);
+
+				promise.set_value(std::move(loader.materials));
+			}
+			catch (...) {
+				promise.set_exception(std::current_exception());
+			}
+		}
+
+		/// the map keeps the future and so the materials alive
+		return future.get();
+	}
+
+	/// gives the materials the textures of their paths, loading the images
+	/// the TextureCache doesn't have
+	void loadTextures (std::vector<Material>& materials) {
+		MTLLoader::loadTextures(materials);
+	}
+};
+
+#endif
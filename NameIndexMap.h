@@ -0,0 +1,118 @@
+#ifndef NAME_INDEX_MAP_H_INCLUDED
+#define NAME_INDEX_MAP_H_INCLUDED
+
+#include <vector>
+#include <string>
+#include <string_view>
+#include <cstdint>
+
+/// maps a name to an index (the material names of MTLLoader); flat open
+/// addressing with linear probing, the names are copied one after the other
+/// in a single string and a slot keeps the hash, so a lookup only compares
+/// the bytes of a name when the hashes match and an insert doesn't allocate
+/// once the buffers are big enough
+class NameIndexMap {
+public:
+	struct Slot {
+		uint64_t hash;
+		uint32_t offset;	/// of the name in names
+		uint32_t length;
+		int32_t value;		/// EMPTY if the slot is free
+	};
+
+	static const int32_t EMPTY = -1;
+
+	std::vector <Slot> slots;
+	std::string names;
+	size_t count = 0;
+	size_t mask = 0;
+
+	size_t size() const {
+		return count;
+	}
+
+	/// keeps the memory for the next names
+	void clear() {
+		for (auto&& slot : slots)
+			slot.value = EMPTY;
+
+		names.clear();
+		count = 0;
+	}
+
+	/// value replaces the one of name if it's already there
+	void insert (std::string_view name, int value) {
+		if ((count + 1) * 2 > slots.size())
+			rehash(slots.size() ? slots.size() * 2 : 16);
+
+		uint64_t h = hash(name);
+		size_t pos = h & mask;
+		while (slots[pos].value != EMPTY) {
+			Slot& slot = slots[pos];
+
+			if (slot.hash == h && nameOf(slot) == name) {
+				slot.value = value;
+				return;
+			}
+
+			pos = (pos + 1) & mask;
+		}
+
+		slots[pos] = Slot{h, (uint32_t)names.size(), (uint32_t)name.size(), value};
+		names.append(name.data(), name.size());
+		count++;
+	}
+
+	/// EMPTY if the name is missing
+	int find (std::string_view name) const {
+		if (slots.size() == 0)
+			return EMPTY;
+
+		uint64_t h = hash(name);
+		size_t pos = h & mask;
+		while (slots[pos].value != EMPTY) {
+			const Slot& slot = slots[pos];
+
+			if (slot.hash == h && nameOf(slot) == name)
+				return slot.value;
+
+			pos = (pos + 1) & mask;
+		}
+
+		return EMPTY;
+	}
+
+	std::string_view nameOf (const Slot& slot) const {
+		return std::string_view(names.data() + slot.offset, slot.length);
+	}
+
+	/// fnv-1a
+	static uint64_t hash (std::string_view name) {
+		uint64_t h = 14695981039346656037ull;
+		for (char c : name)
+			h = (h ^ (unsigned char)c) * 1099511628211ull;
+
+		return h ^ (h >> 32);
+	}
+
+	void rehash (size_t capacity) {
+		std::vector <Slot> old;
+		old.swap(slots);
+
+		slots.assign(capacity, Slot{0, 0, 0, EMPTY});
+		mask = capacity - 1;
+
+		for (auto&& slot : old) {
+			if (slot.value == EMPTY)
+				continue;
+
+			size_t pos = slot.hash & mask;
+			while (slots[pos].value != EMPTY)
+				pos = (pos + 1) & mask;
+
+			slots[pos] = slot;
+		}
+	}
+};
+
+#endif
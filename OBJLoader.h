@@ -6,10 +6,27 @@
 #include <sstream>
 #include <vector>
 #include <map>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+#include <future>
+#include <memory>
 
 #include "MTLLoader.h"
 #include "Mesh.h"
 #include "Util.h"
+#include "TextParse.h"
+#include "MappedFile.h"
+#include "VertexIndexMap.h"
+#include "MeshSink.h"
+#include "MeshCache.h"
+#include "ObjPrescan.h"
+#include "CompressedFile.h"
+#include "ObjIndex.h"
+#include "AsyncMesh.h"
+#include "LoadStats.h"
+#include "Triangulator.h"
+#include "MtlLibrary.h"
 
 template <typename VertexType>
 class OBJLoader {
@@ -21,6 +38,31 @@ public:
 		positions.push_back(Math::Point3f());
 	}
 
+	/// forgets what was loaded, the settings and objIndex stay
+	void clear() {
+		mesh = Mesh<VertexType>();
+		mtlLoader = MTLLoader();
+
+		positions.assign(1, Math::Point3f());
+		texCoords.assign(1, Math::Point2f());
+		normals.assign(1, Math::Point3f());
+
+		faces.clear();
+		currentMtl = 0;
+		mtlForFace.clear();
+		triangles.clear();
+		mtlForTriangle.clear();
+
+		indexMap.clear();
+		vertexCount = 0;
+		lateVertices.clear();
+		lateLimit = LateVertex();
+		mtlFiles.clear();
+
+		pendingMtls.clear();
+		usedMtlNames.clear();
+	}
+
 	std::string currentDirectory = ""; 
 
 	Mesh<VertexType> mesh;
@@ -30,18 +72,43 @@ public:
 	std::vector <Math::Point2f> texCoords;
 	std::vector <Math::Point3f> normals;
 
-	std::vector <std::vector <int>> faces; 
+	FaceList faces; 
 		
 	int currentMtl = 0; 
 	std::vector <int> mtlForFace;
 
-	std::vector <std::tuple<int, int, int>> indexes; 
-	std::map <std::tuple<int, int, int>, int> indexMap; 
+	/// with triangulate, faces of 3 or more corners end up here instead of faces
+	std::vector <int> triangles;
+	std::vector <int> mtlForTriangle;
+
+	VertexIndexMap indexMap; 
 	// 1/2/1 is transformed in 0 
 	// 2/1/2 is tronsformed in 1 
 	// 2/2/1 is transformed in 2	
 	// order of aparence dictates the number wich is given   
 
+	int vertexCount = 0;
+
+	/// vertexes whose face came before their v/vn/vt lines, they are
+	/// completed once the whole file is read (or once they are read, while
+	/// streaming)
+	struct LateVertex {
+		int vertexIndex = 0;
+		int posIndex = 0;
+		int normIndex = 0;
+		int texIndex = 0;
+	};
+	std::vector <LateVertex> lateVertices;
+
+	/// the highest position, normal and texCoord indexes still missing in
+	/// lateVertices, a held back batch only looks at them
+	LateVertex lateLimit;
+
+	/// only while streaming, faces and mtlForFace then hold the current batch
+	MeshSink<VertexType> *sink = nullptr;
+	int sinkBatchSize = 0;
+	std::vector <VertexType> pendingVertices;
+
 
 	/// if OBJLoader is temp we construct the mesh and return it
 	Mesh<VertexType>&& loadMesh (std::string directory, std::string filename) && {
@@ -59,154 +126,1252 @@ public:
 		return mesh; 
 	}
 
+	/// starts the load on another thread with the settings of this loader and
+	/// returns right away; every mtllib is parsed on a thread of its own as
+	/// soon as its line is read, while the geometry parse goes on, and the
+	/// textures are left to AsyncMesh::get
+	AsyncMesh<VertexType> loadMeshAsync (std::string directory, std::string filename) {
+		auto loader = std::make_shared<OBJLoader<VertexType>>();
+		loader->copySettings(*this);
+		loader->asyncMtl = true;
+
+		AsyncMesh<VertexType> result(std::async(std::launch::async,
+				[loader, directory, filename] {
+					loader->loadMesh(directory, filename);
+					return std::move(loader->mesh);
+				}));
+		result.lazyTextures = lazyTextures;
+
+		return result;
+	}
+
+	/// the options below, not what was loaded
+	void copySettings (const OBJLoader& other) {
+		loadMode = other.loadMode;
+		usePrescan = other.usePrescan;
+		useCache = other.useCache;
+		threadCount = other.threadCount;
+		triangulate = other.triangulate;
+		groupByMaterial = other.groupByMaterial;
+		mtlLibrary = other.mtlLibrary;
+		lazyTextures = other.lazyTextures;
+	}
+
+	/// the mesh is sent to the sink in batches of about batchSize faces instead
+	/// of being built in mesh, so memory stays bounded by the batch size for
+	/// the output side only: the v/vn/vt arrays and the dedup map are kept for
+	/// the whole load, a file whose attributes don't fit in memory can't be
+	/// streamed either
+	///
+	/// a batch with vertexes whose v/vn/vt lines come later in the file is
+	/// held back until they are read, so the sink gets the same vertexes
+	/// loadMesh builds
+	void streamMesh (std::string directory, std::string filename,
+			MeshSink<VertexType>& meshSink, int batchSize = 65536)
+	{
+		currentDirectory = directory;
+		sink = &meshSink;
+		sinkBatchSize = batchSize;
+		stats.begin();
+
+		parseFile(filename);
+		flushBatch(true);
+
+		meshSink.setMaterials(mtlLoader.materials);
+		sink = nullptr;
+		stats.end();
+	}
+
+	/// only the o/g sections with these names are parsed, plus the sections
+	/// holding v/vn/vt elements their faces use; objIndex is built on the
+	/// first call and kept, so the next calls on the same file only parse the
+	/// sections they need
+	Mesh<VertexType>&& loadObjects (std::string directory, std::string filename,
+			const std::vector<std::string>& names) &&
+	{
+		currentDirectory = directory;
+		_loadObjects(filename, names);
+
+		return std::move(mesh);
+	}
+
+	Mesh<VertexType>& loadObjects (std::string directory, std::string filename,
+			const std::vector<std::string>& names) &
+	{
+		currentDirectory = directory;
+		_loadObjects(filename, names);
+
+		return mesh;
+	}
+
 	Mesh<VertexType>& getMesh () {
 		return mesh; 
 	}	
 
+	static const int LOAD_STREAM = 0;	/// getline over an ifstream
+	static const int LOAD_MAPPED = 1;	/// tokenize directly over the mmapped file
+	static const int LOAD_THREADED = 2;	/// mmapped file parsed in chunks on threadCount threads
+
+	int loadMode = LOAD_MAPPED;
+
+	/// for LOAD_MAPPED, count the records first so every container is
+	/// reserved once (LOAD_THREADED always counts, it needs the offsets)
+	bool usePrescan = true;
+
+	/// read the mesh from a .meshbin next to the obj if it is still valid,
+	/// else parse the obj and write the .meshbin for the next load
+	bool useCache = false;
+
+	/// sections of the last file given to loadObjects, built again when its
+	/// path, size or mtime change
+	ObjIndex objIndex;
+	MeshCache::FileStamp objIndexStamp;
+
+	/// set on the loader of loadMeshAsync: mtl files are parsed by workers
+	/// with deferred textures, faces get a temporary -2 - k material for the
+	/// k-th usemtl name until resolveMtls, so usemtl names are looked up in
+	/// all the mtl files of the obj, wherever their mtllib line is
+	bool asyncMtl = false;
+	std::vector <std::future<MTLLoader>> pendingMtls;
+	std::map <std::string, int> usedMtlNames;
+
+	/// mtl files loaded so far, the cache depends on them too
+	std::vector <std::string> mtlFiles;
+	int threadCount = 0;	/// for LOAD_THREADED, 0 means one thread per core
+
+	/// polygons are split in triangles while they are parsed (a fan if they
+	/// are convex, ear clipping if not) and go in Mesh::triangleIndex, only
+	/// points and lines stay in elementIndex; a polygon that uses positions
+	/// defined after it is always split in a fan
+	bool triangulate = false;
+
+	/// if set, mtl files come from there instead of being parsed again and
+	/// the textures are not loaded, MtlLibrary::loadTextures does it later
+	MtlLibrary *mtlLibrary = nullptr;
+
+	/// the faces and triangles are sorted by material once loaded and
+	/// Mesh::subMeshes is filled (see Mesh::groupByMaterial), not while streaming
+	bool groupByMaterial = false;
+
+	/// only the texture paths are read, each texture is loaded the first time
+	/// a drawer binds it (see Mesh::getRenderMaterial and prefetchTextures)
+	bool lazyTextures = false;
+
+	/// obj positions of the corners of the face triangulate reads
+	std::vector <int> polygonPositions;
+	std::vector <Math::Point3f> polygonPoints;
+	std::vector <int> polygonTriangles;
+	Triangulator triangulator;
+
+	/// counters and phase times of the last load, build with MESH_LOADER_STATS
+	/// to fill them (see LoadStats.h)
+	LoadStats stats;
+
+	/// attributes the VertexType doesn't have are not parsed and are left
+	/// out of the dedup key, so more corners collapse in the same vertex
+	static constexpr bool hasNormal = VertexType::template has_desc<VertexNormal>();
+	static constexpr bool hasTexCoord = VertexType::template has_desc<VertexTexCoord>();
+
+	static const int LINE_OTHER = 0;
+	static const int LINE_POSITION = 1;
+	static const int LINE_NORMAL = 2;
+	static const int LINE_TEXCOORD = 3;
+	static const int LINE_FACE = 4;
+	static const int LINE_USEMTL = 5;
+	static const int LINE_MTLLIB = 6;
+
 	void _loadMesh (std::string filename) {
 		std::string path = currentDirectory + filename;
-		std::ifstream file(path.c_str());
+		stats.begin();
+
+		if (useCache) {
+			LoadStats::Scope scope(&stats, LoadStats::READ);
 
-		if (!file)
-			throw std::runtime_error(".obj not found: " + filename);
+			if (MeshCache::read(path, mesh, cacheOptions(),
+					!asyncMtl && !mtlLibrary && !lazyTextures))
+			{
+				if (asyncMtl && !lazyTextures)
+					MTLLoader::decodeTextures(mesh.materials);
 
-		std::string line = ""; 
-		while (getline(file, line)) {
-			std::stringstream lineStream(line);
+				stats.end();
+				return;
+			}
+		}
 
-			std::string lineHeader = ""; 
-			lineStream >> lineHeader; 
+		/// vertexes go straight in mesh.vertexList as they are first seen
+		parseFile(filename);
 
-			if (lineHeader == "f") {
-				parseFace(lineStream); 
+		if (asyncMtl) {
+			LoadStats::Scope scope(&stats, LoadStats::MTL);
+			resolveMtls();
+		}
+
+		{
+			LoadStats::Scope scope(&stats, LoadStats::ASSEMBLY);
+
+			completeLateVertices();
+
+			mesh.elementIndex = std::move(faces); 
+			mesh.materialIndex = std::move(mtlForFace); 
+			mesh.triangleIndex = std::move(triangles);
+			mesh.triangleMaterialIndex = std::move(mtlForTriangle);
+			mesh.materials = mtlLoader.materials;
+			mesh.updateRenderMaterials();
+
+			if (groupByMaterial)
+				mesh.groupByMaterial();
+		}
+
+		if (useCache)
+			MeshCache::write(path, mtlFiles, mesh, cacheOptions());
+
+		stats.end();
+	}
+
+	/// the settings that change what is loaded, for MeshCache
+	uint64_t cacheOptions() {
+		return (triangulate ? 1 : 0) | (groupByMaterial ? 2 : 0);
+	}
+
+	void parseFile (std::string filename) {
+		std::string path = currentDirectory + filename;
+
+		/// .obj.gz and .obj.zst are decompressed on a second thread while the
+		/// lines are parsed here, whatever the load mode
+		/// waiting for the file is READ, parseLine switches to TOKENIZE
+		LoadStats::Scope scope(&stats, LoadStats::READ);
+
+		if (CompressedFile::isCompressed(path)) {
+			CompressedFile::forEachLine(path, [&] (const char *begin, const char *end) {
+				stats.addBytes(end - begin + 1);
+				parseLine(begin, end);
+			});
+		}
+		else if (loadMode == LOAD_MAPPED || loadMode == LOAD_THREADED) {
+			MappedFile file;
+			if (!file.open(path))
+				throw std::runtime_error(".obj not found: " + filename);
+
+			stats.addBytes(file.size);
+
+			if (loadMode == LOAD_THREADED) {
+				parseThreaded(file.begin(), file.end());
+			}
+			else {
+				if (usePrescan)
+					reserveContainers(ObjPrescan::count(file.begin(), file.end()));
+
+				forEachLine(file.begin(), file.end(), [&] (const char *begin, const char *end) {
+					parseLine(begin, end);
+				});
+			}
+		}
+		else {
+			std::ifstream file(path.c_str());
+
+			if (!file)
+				throw std::runtime_error(".obj not found: " + filename);
+
+			std::string line = ""; 
+			while (getline(file, line)) {
+				stats.addBytes(line.size() + 1);
+				parseLine(line.data(), line.data() + line.size());
 			}
-			else if (lineHeader == "v") {
-				parsePosition(lineStream); 
+
+			file.close();
+		}
+
+		notePeaks();
+	}
+
+	void notePeaks() {
+		stats.notePeaks(positions.size(), normals.size(), texCoords.size(), faces.size(),
+				sink ? vertexCount : mesh.vertexList.size(), indexMap.slots.size());
+	}
+
+	void countLine (int type) {
+		switch (type) {
+			case LINE_POSITION:	stats.positionLines++;	break;
+			case LINE_NORMAL:	stats.normalLines++;	break;
+			case LINE_TEXCOORD:	stats.texCoordLines++;	break;
+			case LINE_FACE:		stats.faceLines++;		break;
+			case LINE_USEMTL:	stats.usemtlLines++;	break;
+			case LINE_MTLLIB:	stats.mtllibLines++;	break;
+			default:			stats.otherLines++;		break;
+		}
+	}
+
+	bool isReadYet (int posIndex, int normIndex, int texIndex) {
+		return posIndex < positions.size() && normIndex < normals.size() &&
+				texIndex < texCoords.size();
+	}
+
+	/// indexes past what was read so far use the sentinels
+	VertexType makeVertex (int posIndex, int normIndex, int texIndex) {
+		VertexType vetex; 
+
+		vetex.template setIfExists<VertexPosition>(
+				positions[posIndex < positions.size() ? posIndex : 0]);
+		vetex.template setIfExists<VertexNormal>(
+				normals[normIndex < normals.size() ? normIndex : 0]);
+		vetex.template setIfExists<VertexTexCoord>(
+				texCoords[texIndex < texCoords.size() ? texIndex : 0]);
+
+		return vetex;
+	}
+
+	/// the header is dispatched on it's bytes, nothing is allocated per line
+	static int lineType (std::string_view lineHeader) {
+		if (lineHeader.size() == 0)
+			return LINE_OTHER;
+
+		switch (lineHeader[0]) {
+			case 'f':
+				if (lineHeader.size() == 1)
+					return LINE_FACE;
+				break;
+			case 'v':
+				if (lineHeader.size() == 1)
+					return LINE_POSITION;
+				else if (lineHeader == "vn")
+					return LINE_NORMAL;
+				else if (lineHeader == "vt")
+					return LINE_TEXCOORD;
+				break;
+			case 'u':
+				if (lineHeader == "usemtl")
+					return LINE_USEMTL;
+				break;
+			case 'm':
+				if (lineHeader == "mtllib")
+					return LINE_MTLLIB;
+				break;
+		}
+
+		return LINE_OTHER;
+	}
+
+	void parseLine (const char *begin, const char *end) {
+		LoadStats::Scope scope(&stats, LoadStats::TOKENIZE);
+		TextCursor line(begin, end);
+		int type = lineType(line.nextToken());
+
+		if constexpr (LoadStats::enabled)
+			countLine(type);
+
+		switch (type) {
+			case LINE_FACE:		parseFace(line);		break;
+			case LINE_POSITION:	parsePosition(line);	break;
+			case LINE_NORMAL:
+				if constexpr (hasNormal)
+					parseNormal(line);
+				break;
+			case LINE_TEXCOORD:
+				if constexpr (hasTexCoord)
+					parseTexCoord(line);
+				break;
+			case LINE_USEMTL:	parseUseMTL(line);		break;
+			case LINE_MTLLIB:	parseLibMTL(line);		break;
+		}
+	}
+
+	void parseUseMTL (TextCursor& line) {
+		std::string mtlName(line.nextToken()); 
+
+		useMtl(mtlName);
+	}
+
+	void useMtl (const std::string& mtlName) {
+		if (!asyncMtl) {
+			currentMtl = mtlLoader.getMaterialIndex(mtlName);
+			return;
+		}
+
+		auto it = usedMtlNames.find(mtlName);
+		if (it == usedMtlNames.end())
+			it = usedMtlNames.emplace(mtlName, -2 - (int)usedMtlNames.size()).first;
+
+		currentMtl = it->second;
+	}
+
+	void parseLibMTL (TextCursor& line) {
+		std::string mtlName(line.nextToken());
+
+		loadMtl(mtlName);
+	}
+
+	void loadMtl (std::string mtlName) {
+		LoadStats::Scope scope(&stats, LoadStats::MTL);
+
+		if (asyncMtl) {
+			std::string directory = currentDirectory;
+			MtlLibrary *library = mtlLibrary;
+			bool lazy = lazyTextures;
+
+			pendingMtls.push_back(std::async(std::launch::async, [directory, mtlName, library, lazy] {
+				MTLLoader loader;
+				loader.deferTextures = true;
+
+				if (library) {
+					for (auto&& material : library->get(directory, mtlName))
+						loader.addMaterial(material);
+				}
+				else {
+					loader.loadMtl(directory, mtlName);
+				}
+
+				if (!lazy)
+					MTLLoader::decodeTextures(loader.materials);
+				return loader;
+			}));
+		}
+		else if (mtlLibrary) {
+			for (auto&& material : mtlLibrary->get(currentDirectory, mtlName))
+				mtlLoader.addMaterial(material);
+		}
+		else {
+			mtlLoader.stats = &stats;
+			mtlLoader.deferTextures = lazyTextures;
+			mtlLoader.loadMtl(currentDirectory, mtlName);
+		}
+
+		mtlFiles.push_back(currentDirectory + mtlName);
+	}
+
+	/// waits for the mtl workers and gives the faces their real materials
+	void resolveMtls() {
+		for (auto&& pending : pendingMtls) {
+			MTLLoader loader = pending.get();
+
+			for (auto&& material : loader.materials)
+				mtlLoader.addMaterial(std::move(material));
+		}
+		pendingMtls.clear();
+
+		std::vector <int> resolved(usedMtlNames.size());
+		for (auto&& [name, id] : usedMtlNames)
+			resolved[-2 - id] = mtlLoader.getMaterialIndex(name);
+
+		for (auto&& mtl : mtlForFace)
+			if (mtl <= -2)
+				mtl = resolved[-2 - mtl];
+
+		for (auto&& mtl : mtlForTriangle)
+			if (mtl <= -2)
+				mtl = resolved[-2 - mtl];
+
+		usedMtlNames.clear();
+	}
+
+	static Math::Point3f readPoint3 (TextCursor& line) {
+		float x = 0, y = 0, z = 0;
+		line.nextFloat(x) && line.nextFloat(y) && line.nextFloat(z);
+
+		return Math::Point3f(x, y, z);
+	}
+
+	static Math::Point2f readPoint2 (TextCursor& line) {
+		float u = 0, v = 0;
+		line.nextFloat(u) && line.nextFloat(v);
+
+		return Math::Point2f(u, v);
+	}
+
+	/// v, v/vt, v//vn or v/vt/vn, 0 means the index is not being used
+	static void readFaceCorner (TextCursor& line, int& posIndex, int& texIndex, int& normIndex) {
+		posIndex = 0;
+		texIndex = 0;
+		normIndex = 0; 
+
+		const char *&p = line.cur;
+		TextCursor::parseInt(p, line.end, posIndex);
+
+		if (p < line.end && *p == '/') {
+			p++;
+			TextCursor::parseInt(p, line.end, texIndex);
+
+			if (p < line.end && *p == '/') {
+				p++;
+				TextCursor::parseInt(p, line.end, normIndex);
+			}
+		}
+
+		while (p < line.end && !TextCursor::isBlank(*p))	/// junk after the corner
+			p++;
+	}
+
+	/// negative indexes are relative to the vecSize elements read so far
+	static int fitObjIndex (int vecSize, int index) {
+		if (index < 0) {
+			index = std::min(
+				std::max(
+					vecSize + index + 1, 
+					0
+				), 
+				vecSize - 1
+			);
+		}
+		return index; 
+	}
+
+	/// resolves the corner against the element counts read so far
+	static void fitCorner (int& posIndex, int& normIndex, int& texIndex,
+			int positionCount, int normalCount, int texCoordCount)
+	{
+		posIndex = fitObjIndex(positionCount, posIndex);
+
+		if constexpr (hasNormal)
+			normIndex = fitObjIndex(normalCount, normIndex);
+		else
+			normIndex = 0;
+
+		if constexpr (hasTexCoord)
+			texIndex = fitObjIndex(texCoordCount, texIndex);
+		else
+			texIndex = 0;
+	}
+
+	void parsePosition (TextCursor& line) {
+		positions.push_back(readPoint3(line));
+	}
+
+	void parseNormal (TextCursor& line) {
+		normals.push_back(readPoint3(line));
+	}
+
+	void parseTexCoord (TextCursor& line) {
+		texCoords.push_back(readPoint2(line));
+	}
+
+	void parseFace (TextCursor& line) {
+		beginFace();
+	
+		while (!line.atEnd()) {
+			int posIndex, texIndex, normIndex;
+			readFaceCorner(line, posIndex, texIndex, normIndex);
+
+			fitCorner(posIndex, normIndex, texIndex, positions.size(), normals.size(),
+					texCoords.size());
+
+			addFaceVertex(posIndex, normIndex, texIndex);
+		}
+
+		endFace();
+	}
+
+	/// adds the vertex to the last face
+	void addFaceVertex (int posIndex, int normIndex, int texIndex) {
+		bool inserted = false;
+		int vertexIndex;
+		{
+			LoadStats::Scope scope(&stats, LoadStats::DEDUP);
+			vertexIndex = indexMap.findOrInsert(posIndex, normIndex, texIndex, vertexCount,
+					inserted);
+		}
+
+		stats.addCorner(inserted);
+
+		if (inserted) {
+			LoadStats::Scope scope(&stats, LoadStats::ASSEMBLY);
+			vertexCount++;
+
+			if (!isReadYet(posIndex, normIndex, texIndex)) {
+				lateVertices.push_back({vertexIndex, posIndex, normIndex, texIndex});
+
+				lateLimit.posIndex = std::max(lateLimit.posIndex, posIndex);
+				lateLimit.normIndex = std::max(lateLimit.normIndex, normIndex);
+				lateLimit.texIndex = std::max(lateLimit.texIndex, texIndex);
 			}
-			else if (lineHeader == "vn") {
-				parseNormal(lineStream); 
+
+			if (sink)
+				pendingVertices.push_back(makeVertex(posIndex, normIndex, texIndex));
+			else
+				mesh.vertexList.push_back(makeVertex(posIndex, normIndex, texIndex));
+		}
+
+		faces.addCorner(vertexIndex);
+
+		if (triangulate)
+			polygonPositions.push_back(posIndex);
+	}
+
+	void beginFace() {
+		faces.addFace();
+		mtlForFace.push_back(currentMtl);
+
+		if (triangulate)
+			polygonPositions.clear();
+	}
+
+	void endFace() {
+		if (triangulate)
+			triangulateFace();
+
+		if (sink && faces.size() + mtlForTriangle.size() >= sinkBatchSize)
+			flushBatch();
+	}
+
+	/// moves the last face in triangles, points and lines are left alone
+	void triangulateFace() {
+		FaceList::Face face = faces.back();
+		if (face.size() < 3)
+			return;
+
+		polygonTriangles.clear();
+
+		if (face.size() == 3) {
+			Triangulator::fan(3, polygonTriangles);
+		}
+		else {
+			bool isRead = true;
+			polygonPoints.clear();
+
+			for (int posIndex : polygonPositions) {
+				isRead = isRead && posIndex < positions.size();
+				polygonPoints.push_back(positions[posIndex < positions.size() ? posIndex : 0]);
 			}
-			else if (lineHeader == "vt") {
-				parseTexCoord(lineStream); 
+
+			if (isRead)
+				triangulator.triangulate(polygonPoints.data(), face.size(), polygonTriangles);
+			else
+				Triangulator::fan(face.size(), polygonTriangles);
+		}
+
+		for (int corner : polygonTriangles)
+			triangles.push_back(face[corner]);
+		mtlForTriangle.insert(mtlForTriangle.end(), polygonTriangles.size() / 3, mtlForFace.back());
+
+		faces.pop_back();
+		mtlForFace.pop_back();
+	}
+
+	/// the vertexes go first, the faces of the batch may use them; the batch
+	/// waits while some of its vertexes are late, except the last one
+	void flushBatch (bool last = false) {
+		if (!sink)
+			return;
+
+		if (!completeBatchLateVertices(last) && !last)
+			return;
+
+		notePeaks();
+
+		if (pendingVertices.size())
+			sink->addVertices(pendingVertices);
+
+		if (faces.size())
+			sink->addFaces(faces, mtlForFace);
+
+		if (triangles.size())
+			sink->addTriangles(triangles, mtlForTriangle);
+
+		pendingVertices.clear();
+		faces.clear();
+		mtlForFace.clear();
+		triangles.clear();
+		mtlForTriangle.clear();
+	}
+
+	/// remakes the late vertexes of the mesh once the whole file is read
+	void completeLateVertices() {
+		for (auto&& late : lateVertices)
+			mesh.vertexList[late.vertexIndex] = makeVertex(late.posIndex, late.normIndex,
+					late.texIndex);
+		lateVertices.clear();
+		lateLimit = LateVertex();
+	}
+
+	/// remakes the late vertexes of the batch once all of them can be made
+	/// (or anyway if last), true if none is left; until then it costs a
+	/// single check against lateLimit
+	bool completeBatchLateVertices (bool last) {
+		if (!last && !isReadYet(lateLimit.posIndex, lateLimit.normIndex, lateLimit.texIndex))
+			return false;
+
+		int firstPending = vertexCount - pendingVertices.size();
+
+		for (auto&& late : lateVertices)
+			pendingVertices[late.vertexIndex - firstPending] = makeVertex(late.posIndex,
+					late.normIndex, late.texIndex);
+
+		lateVertices.clear();
+		lateLimit = LateVertex();
+		return true;
+	}
+
+	/// a line aligned piece of the file, parsed independently of the others
+	struct ObjChunk {
+		const char *begin = nullptr;
+		const char *end = nullptr;
+
+		/// elements before this chunk, sentinels included
+		int positionBase = 0;
+		int normalBase = 0;
+		int texCoordBase = 0;
+
+		ObjPrescan::Counts counts;
+
+		std::vector <Math::Point3f> positions; 
+		std::vector <Math::Point2f> texCoords;
+		std::vector <Math::Point3f> normals;
+
+		/// absolute pos, norm, tex triplets of all the faces, back to back
+		std::vector <int> corners;
+		std::vector <int> faceSizes;
+
+		/// usemtl and mtllib lines, replayed in order during the merge
+		struct MtlEvent {
+			int faceIndex;
+			int type;
+			std::string_view name;
+			int mtl = 0;	/// currentMtl once the line was replayed
+		};
+		std::vector <MtlEvent> mtlEvents;
+
+		/// for the parallel merge: the distinct corners of the chunk as pos,
+		/// norm, tex triplets in the order they first appear, and for every
+		/// corner the index of its triplet
+		std::vector <int> localVertices;
+		std::vector <int> localIndex;
+
+		/// index in the mesh of every local vertex, the local vertexes the
+		/// mesh didn't have yet become the ones from vertexBase on
+		std::vector <int> remap;
+		std::vector <int> newVertices;
+		int vertexBase = 0;
+
+		int faceBase = 0;
+		int cornerBase = 0;
+		int mtlAtBegin = 0;
+	};
+
+	/// there can't be more distinct vertexes than corners, but usually there
+	/// are a lot less, so that estimate is also bounded by the attribute counts
+	void reserveContainers (const ObjPrescan::Counts& counts) {
+		size_t attributes = std::max({counts.positions,
+				hasNormal ? counts.normals : 0, hasTexCoord ? counts.texCoords : 0});
+		size_t estimate = std::min(counts.corners, attributes * 2);
+
+		positions.reserve(positions.size() + counts.positions);
+		if constexpr (hasNormal)
+			normals.reserve(normals.size() + counts.normals);
+		if constexpr (hasTexCoord)
+			texCoords.reserve(texCoords.size() + counts.texCoords);
+
+		indexMap.reserve(indexMap.size() + estimate);
+
+		/// while streaming these only hold a batch
+		if (!sink) {
+			if (triangulate) {
+				/// a polygon of n corners gives n - 2 triangles
+				size_t triangleCount = counts.corners > counts.faces * 2 ?
+						counts.corners - counts.faces * 2 : 0;
+
+				triangles.reserve(triangles.size() + triangleCount * 3);
+				mtlForTriangle.reserve(mtlForTriangle.size() + triangleCount);
 			}
-			else if (lineHeader == "usemtl") {
-				parseUseMTL(lineStream); 
+			else {
+				faces.reserve(faces.size() + counts.faces, faces.cornerCount() + counts.corners);
+				mtlForFace.reserve(mtlForFace.size() + counts.faces);
 			}
-			else if (lineHeader == "mtllib") {
-				parseLibMTL(lineStream); 
+			mesh.vertexList.reserve(mesh.vertexList.size() + estimate);
+		}
+	}
+
+	/// chunks are counted, then parsed on threadCount threads, then merged in
+	/// file order, so the result is the same as the one of the serial parser
+	///
+	/// the corners are deduplicated inside each chunk on the workers, only
+	/// the distinct ones of every chunk go through indexMap in file order,
+	/// then the workers write the vertexes and faces in place; that serial
+	/// remap (and the mtl lines) is what is left on the calling thread, when
+	/// streaming or triangulating the faces are still merged one by one
+	void parseThreaded (const char *begin, const char *end) {
+		int workers = threadCount > 0 ? threadCount : std::thread::hardware_concurrency();
+		workers = std::max(workers, 1);
+
+		/// more chunks than threads so a slow chunk doesn't stall everyone
+		size_t chunkCount = workers * 4;
+		size_t chunkSize = std::max<size_t>((end - begin) / chunkCount, 1 << 16);
+
+		std::vector <ObjChunk> chunks;
+		const char *chunkBegin = begin;
+		while (chunkBegin < end) {
+			const char *chunkEnd = chunkBegin + std::min<size_t>(chunkSize, end - chunkBegin);
+			chunkEnd = (const char *)memchr(chunkEnd, '\n', end - chunkEnd);
+			chunkEnd = chunkEnd ? chunkEnd + 1 : end;
+
+			chunks.emplace_back();
+			chunks.back().begin = chunkBegin;
+			chunks.back().end = chunkEnd;
+			chunkBegin = chunkEnd;
+		}
+
+		auto runOnWorkers = [&] (auto&& func) {
+			std::atomic<size_t> next(0);
+			auto work = [&] () {
+				for (size_t i = next++; i < chunks.size(); i = next++)
+					func(chunks[i]);
+			};
+
+			std::vector <std::thread> threads;
+			for (int i = 1; i < std::min<size_t>(workers, chunks.size()); i++)
+				threads.emplace_back(work);
+			work();
+
+			for (auto&& thread : threads)
+				thread.join();
+		};
+
+		/// the passes run on workers, they are timed as a whole here
+		{
+			LoadStats::Scope scope(&stats, LoadStats::READ);
+
+			runOnWorkers([] (ObjChunk& chunk) {
+				countChunk(chunk);
+			});
+		}
+
+		ObjPrescan::Counts counts;
+		int positionBase = positions.size();
+		int normalBase = normals.size();
+		int texCoordBase = texCoords.size();
+		for (auto&& chunk : chunks) {
+			counts.positions += chunk.counts.positions;
+			counts.normals += chunk.counts.normals;
+			counts.texCoords += chunk.counts.texCoords;
+			counts.faces += chunk.counts.faces;
+			counts.corners += chunk.counts.corners;
+
+			chunk.positionBase = positionBase;
+			chunk.normalBase = normalBase;
+			chunk.texCoordBase = texCoordBase;
+
+			positionBase += chunk.counts.positions;
+			normalBase += chunk.counts.normals;
+			texCoordBase += chunk.counts.texCoords;
+		}
+
+		{
+			LoadStats::Scope scope(&stats, LoadStats::TOKENIZE);
+
+			runOnWorkers([] (ObjChunk& chunk) {
+				parseChunk(chunk);
+			});
+		}
+
+		for (auto&& chunk : chunks)
+			addChunkCounts(chunk);
+
+		reserveContainers(counts);
+
+		/// faces are built one at a time when streaming (batches) or
+		/// triangulating (the polygon scratch), so those merge serially
+		if (sink || triangulate) {
+			for (auto&& chunk : chunks) {
+				appendChunkElements(chunk);
+				mergeChunkFaces(chunk);
+				chunk = ObjChunk();
 			}
+
+			return;
 		}
 
-		for (int index = 0; index < indexes.size(); index++) {
-			VertexType vetex; 
+		for (auto&& chunk : chunks)
+			appendChunkElements(chunk);
+
+		{
+			LoadStats::Scope scope(&stats, LoadStats::DEDUP);
 
-			vetex.template setIfExists<VertexPosition>(positions[std::get<0>(indexes[index])]);
-			vetex.template setIfExists<VertexNormal>(normals[std::get<1>(indexes[index])]);
-			vetex.template setIfExists<VertexTexCoord>(texCoords[std::get<2>(indexes[index])]);
+			runOnWorkers([] (ObjChunk& chunk) {
+				dedupChunk(chunk);
+			});
 
-			mesh.addVertex(vetex); 
+			for (auto&& chunk : chunks)
+				remapChunk(chunk);
 		}
 
-		mesh.elementIndex = faces; 
-		mesh.materialIndex = mtlForFace; 
-		mesh.materials = mtlLoader.materials;
-		
-		file.close();
+		/// where the faces of each chunk go
+		size_t faceBase = faces.size();
+		size_t cornerBase = faces.cornerCount();
+		for (auto&& chunk : chunks) {
+			chunk.faceBase = faceBase;
+			chunk.cornerBase = cornerBase;
+			faceBase += chunk.faceSizes.size();
+			cornerBase += chunk.localIndex.size();
+
+			replayMtlEvents(chunk);
+		}
+
+		{
+			LoadStats::Scope scope(&stats, LoadStats::ASSEMBLY);
+
+			mesh.vertexList.resize(vertexCount);
+			faces.offsets.resize(faceBase + 1);
+			faces.indexes.resize(cornerBase);
+			mtlForFace.resize(faceBase);
+
+			runOnWorkers([&] (ObjChunk& chunk) {
+				assembleChunk(chunk);
+				chunk = ObjChunk();
+			});
+		}
 	}
 
-	void parseUseMTL (std::stringstream& stream) {
-		std::string mtlName; 
-		stream >> mtlName; 
+	/// v, vn and vt of the chunk after the ones of the chunks before it
+	void appendChunkElements (const ObjChunk& chunk) {
+		LoadStats::Scope scope(&stats, LoadStats::ASSEMBLY);
 
-		currentMtl = mtlLoader.getMaterialIndex(mtlName);
+		positions.insert(positions.end(), chunk.positions.begin(), chunk.positions.end());
+		normals.insert(normals.end(), chunk.normals.begin(), chunk.normals.end());
+		texCoords.insert(texCoords.end(), chunk.texCoords.begin(), chunk.texCoords.end());
 	}
 
-	void parseLibMTL (std::stringstream& stream) {
-		std::string mtlName; 
-		stream >> mtlName;
+	/// the prescan counts of the chunk, with the mtl lines it parsed
+	void addChunkCounts (const ObjChunk& chunk) {
+		size_t usemtlLines = 0;
+		for (auto&& mtlEvent : chunk.mtlEvents)
+			usemtlLines += mtlEvent.type == LINE_USEMTL;
 
-		mtlLoader.loadMtl(currentDirectory, mtlName);  
+		stats.addCounts(chunk.counts, usemtlLines, chunk.mtlEvents.size() - usemtlLines);
 	}
 
-	void parsePosition (std::stringstream& stream) {
-		Math::Point3f position; 
-		stream >> position; 
+	/// on a worker: the corners of the chunk deduplicated among themselves
+	static void dedupChunk (ObjChunk& chunk) {
+		VertexIndexMap localMap;
+		localMap.reserve(chunk.corners.size() / 3);
+		chunk.localIndex.resize(chunk.corners.size() / 3);
+
+		for (size_t i = 0; i < chunk.localIndex.size(); i++) {
+			const int *corner = &chunk.corners[i * 3];
+			bool inserted = false;
 
-		positions.push_back(position);
+			chunk.localIndex[i] = localMap.findOrInsert(corner[0], corner[1], corner[2],
+					chunk.localVertices.size() / 3, inserted);
+
+			if (inserted)
+				chunk.localVertices.insert(chunk.localVertices.end(), corner, corner + 3);
+		}
+
+		chunk.corners = std::vector<int>();
 	}
 
-	void parseNormal (std::stringstream& stream) {
-		Math::Point3f normal; 
-		stream >> normal; 
+	/// in file order: only the distinct corners of each chunk are looked up
+	/// in indexMap, a vertex is new if no chunk before had it, so the vertexes
+	/// keep the order the serial parser gives them
+	void remapChunk (ObjChunk& chunk) {
+		size_t localCount = chunk.localVertices.size() / 3;
+		chunk.remap.resize(localCount);
+		chunk.vertexBase = vertexCount;
+
+		for (size_t i = 0; i < localCount; i++) {
+			const int *corner = &chunk.localVertices[i * 3];
+			bool inserted = false;
+
+			chunk.remap[i] = indexMap.findOrInsert(corner[0], corner[1], corner[2], vertexCount,
+					inserted);
 
-		normals.push_back(normal);
+			if (inserted) {
+				vertexCount++;
+				chunk.newVertices.push_back(i);
+			}
+		}
+
+		if constexpr (LoadStats::enabled) {
+			stats.corners += chunk.localIndex.size();
+			stats.uniqueVertexes += chunk.newVertices.size();
+		}
 	}
 
-	void parseTexCoord (std::stringstream& stream) {
-		Math::Point2f texCoord; 
-		stream >> texCoord; 
+	/// in file order: the usemtl and mtllib lines, so the faces know their material
+	void replayMtlEvents (ObjChunk& chunk) {
+		chunk.mtlAtBegin = currentMtl;
+
+		for (auto&& mtlEvent : chunk.mtlEvents) {
+			std::string name(mtlEvent.name);
 
-		texCoords.push_back(texCoord);
+			if (mtlEvent.type == LINE_USEMTL)
+				useMtl(name);
+			else
+				loadMtl(name);
+
+			mtlEvent.mtl = currentMtl;
+		}
 	}
 
-	void parseFace (std::stringstream& stream) {
-		int faceVertexCount = 0;
-		std::string faceVertexIndexes = ""; 
+	/// on a worker: the new vertexes and the faces of the chunk, written in
+	/// the places remapChunk and replayMtlEvents gave them
+	void assembleChunk (ObjChunk& chunk) {
+		for (size_t i = 0; i < chunk.newVertices.size(); i++) {
+			const int *corner = &chunk.localVertices[chunk.newVertices[i] * 3];
+			mesh.vertexList[chunk.vertexBase + i] = makeVertex(corner[0], corner[1], corner[2]);
+		}
 
-		faces.push_back(std::vector<int>()); 
-		mtlForFace.push_back(currentMtl); 
-	
-		while (stream >> faceVertexIndexes) {
-			auto vertexIDS = Util::split(faceVertexIndexes, '/');
+		size_t event = 0;
+		int mtl = chunk.mtlAtBegin;
+		int corner = 0;
+
+		for (int i = 0; i < chunk.faceSizes.size(); i++) {
+			for (; event < chunk.mtlEvents.size() && chunk.mtlEvents[event].faceIndex == i; event++)
+				mtl = chunk.mtlEvents[event].mtl;
 
-			/// 0 means the index is not being used
-			int posIndex = 0;
-			int texIndex = 0;
-			int normIndex = 0; 
+			for (int j = 0; j < chunk.faceSizes[i]; j++, corner++)
+				faces.indexes[chunk.cornerBase + corner] = chunk.remap[chunk.localIndex[corner]];
 
-			// int validIndexes = 0; 
-			if (vertexIDS.size() > 1 && vertexIDS[0] != "") {	/// position 
-				posIndex = Util::stringToNumber<int>(vertexIDS[0]); 
+			faces.offsets[chunk.faceBase + i + 1] = chunk.cornerBase + corner;
+			mtlForFace[chunk.faceBase + i] = mtl;
+		}
+	}
+
+	static void countChunk (ObjChunk& chunk) {
+		chunk.counts = ObjPrescan::count(chunk.begin, chunk.end);
+	}
+
+	/// without faces only the v/vn/vt lines are read
+	static void parseChunk (ObjChunk& chunk, bool withFaces = true) {
+		chunk.positions.reserve(chunk.counts.positions);
+		if constexpr (hasNormal)
+			chunk.normals.reserve(chunk.counts.normals);
+		if constexpr (hasTexCoord)
+			chunk.texCoords.reserve(chunk.counts.texCoords);
+		if (withFaces) {
+			chunk.corners.reserve(chunk.counts.corners * 3);
+			chunk.faceSizes.reserve(chunk.counts.faces);
+		}
+
+		forEachLine(chunk.begin, chunk.end, [&] (const char *begin, const char *end) {
+			TextCursor line(begin, end);
+			int type = lineType(line.nextToken());
+
+			switch (type) {
+				case LINE_POSITION:
+					chunk.positions.push_back(readPoint3(line));
+					break;
+				case LINE_NORMAL:
+					if constexpr (hasNormal)
+						chunk.normals.push_back(readPoint3(line));
+					break;
+				case LINE_TEXCOORD:
+					if constexpr (hasTexCoord)
+						chunk.texCoords.push_back(readPoint2(line));
+					break;
+				case LINE_USEMTL:
+				case LINE_MTLLIB:
+					if (withFaces)
+						chunk.mtlEvents.push_back({(int)chunk.faceSizes.size(), type, line.nextToken()});
+					break;
+				case LINE_FACE: {
+					if (!withFaces)
+						break;
+
+					int positionCount = chunk.positionBase + chunk.positions.size();
+					int normalCount = chunk.normalBase + chunk.normals.size();
+					int texCoordCount = chunk.texCoordBase + chunk.texCoords.size();
+					int faceSize = 0;
+
+					while (!line.atEnd()) {
+						int posIndex, texIndex, normIndex;
+						readFaceCorner(line, posIndex, texIndex, normIndex);
+
+						fitCorner(posIndex, normIndex, texIndex, positionCount, normalCount,
+								texCoordCount);
+
+						chunk.corners.push_back(posIndex);
+						chunk.corners.push_back(normIndex);
+						chunk.corners.push_back(texIndex);
+						faceSize++;
+					}
+
+					chunk.faceSizes.push_back(faceSize);
+					break;
+				}
 			}
+		});
+	}
 
-			if (vertexIDS.size() > 2 && vertexIDS[1] != "") {	/// normal 
-				texIndex = Util::stringToNumber<int>(vertexIDS[1]); 
+	void mergeChunkFaces (ObjChunk& chunk) {
+		size_t event = 0;
+		auto applyEvents = [&] (int faceIndex) {
+			for (; event < chunk.mtlEvents.size() && chunk.mtlEvents[event].faceIndex == faceIndex; event++) {
+				auto& mtlEvent = chunk.mtlEvents[event];
+				std::string name(mtlEvent.name);
+
+				if (mtlEvent.type == LINE_USEMTL)
+					useMtl(name);
+				else
+					loadMtl(name);
 			}
+		};
+
+		const int *corner = chunk.corners.data();
+		for (int i = 0; i < chunk.faceSizes.size(); i++) {
+			applyEvents(i);
+
+			beginFace();
 
-			if (vertexIDS.size() > 3 && vertexIDS[2] != "") {	/// texture coordinate
-				normIndex = Util::stringToNumber<int>(vertexIDS[2]); 
+			for (int j = 0; j < chunk.faceSizes[i]; j++, corner += 3)
+				addFaceVertex(corner[0], corner[1], corner[2]);
+
+			endFace();
+		}
+
+		applyEvents(chunk.faceSizes.size());
+	}
+
+	/// obj index ranges and where their elements were packed, for loadObjects
+	struct PackedRanges {
+		std::vector <int> objBegin;
+		std::vector <int> packedBegin;
+		std::vector <int> count;
+
+		void add (int obj, int packed, int elementCount) {
+			if (elementCount == 0)
+				return;
+
+			objBegin.push_back(obj);
+			packedBegin.push_back(packed);
+			count.push_back(elementCount);
+		}
+
+		/// elements that were not packed become the sentinel
+		int toPacked (int index) const {
+			auto it = std::upper_bound(objBegin.begin(), objBegin.end(), index);
+			if (it == objBegin.begin())
+				return 0;
+
+			int range = it - 1 - objBegin.begin();
+			if (index - objBegin[range] >= count[range])
+				return 0;
+
+			return packedBegin[range] + index - objBegin[range];
+		}
+	};
+
+	void _loadObjects (std::string filename, const std::vector<std::string>& names) {
+		std::string path = currentDirectory + filename;
+
+		if (CompressedFile::isCompressed(path))
+			throw std::runtime_error("can't load objects of a compressed .obj: " + filename);
+
+		stats.begin();
+		MappedFile file;
+		{
+			LoadStats::Scope scope(&stats, LoadStats::READ);
+
+			if (!file.open(path))
+				throw std::runtime_error(".obj not found: " + filename);
+
+			MeshCache::FileStamp stamp;
+			MeshCache::stampFile(path, stamp);
+
+			if (stamp.path != objIndexStamp.path || stamp.size != objIndexStamp.size ||
+					stamp.mtime != objIndexStamp.mtime || objIndex.fileSize != file.size)
+			{
+				objIndex.build(file.begin(), file.end());
+				objIndexStamp = stamp;
 			}
+		}
 
-			auto fitObjIndex = [](int vecSize, int index) {
-				if (index < 0) {
-					index = std::min(
-						std::max(
-							vecSize + index + 1, 
-							0
-						), 
-						vecSize - 1
-					);
-				}
-				return index; 
-			};
+		clear();
 
-			posIndex = fitObjIndex(positions.size(), posIndex);
-			normIndex = fitObjIndex(normals.size(), normIndex);
-			texIndex = fitObjIndex(texCoords.size(), texIndex);
+		for (auto&& mtlLib : objIndex.mtlLibs)
+			loadMtl(mtlLib);
 
-			auto vertexIndexes = std::make_tuple(posIndex, normIndex, texIndex); 
+		/// parsed sections by index, the selected ones with their faces
+		std::map <int, ObjChunk> chunks;
+		auto addChunk = [&] (int section, bool withFaces) {
+			const ObjIndex::Section& info = objIndex.sections[section];
+			ObjChunk& chunk = chunks[section];
 
-			int vertexIndex = 0; 
+			chunk.begin = file.begin() + info.begin;
+			chunk.end = file.begin() + info.end;
+			chunk.positionBase = info.positionBase;
+			chunk.normalBase = info.normalBase;
+			chunk.texCoordBase = info.texCoordBase;
+			chunk.counts = info.counts;
 
-			if (indexMap.find(vertexIndexes) == indexMap.end()) {
-				indexes.push_back(vertexIndexes);
-				indexMap[vertexIndexes] = indexes.size() - 1;  
+			LoadStats::Scope scope(&stats, LoadStats::TOKENIZE);
+			stats.addBytes(info.end - info.begin);
+
+			parseChunk(chunk, withFaces);
+			if (withFaces)
+				addChunkCounts(chunk);
+		};
+
+		std::vector <int> selected = objIndex.find(names);
+		for (int section : selected)
+			addChunk(section, true);
+
+		/// faces can use elements of any section before them
+		auto need = [&] (int section) {
+			if (section >= 0 && chunks.find(section) == chunks.end())
+				addChunk(section, false);
+		};
+
+		for (int section : selected) {
+			ObjChunk& chunk = chunks[section];
+
+			for (size_t i = 0; i < chunk.corners.size(); i += 3) {
+				int posIndex = chunk.corners[i] - chunk.positionBase;
+				int normIndex = chunk.corners[i + 1] - chunk.normalBase;
+				int texIndex = chunk.corners[i + 2] - chunk.texCoordBase;
+
+				if (posIndex < 0 || posIndex >= chunk.positions.size())
+					need(objIndex.sectionOfPosition(chunk.corners[i]));
+				if (normIndex < 0 || normIndex >= chunk.normals.size())
+					need(objIndex.sectionOfNormal(chunk.corners[i + 1]));
+				if (texIndex < 0 || texIndex >= chunk.texCoords.size())
+					need(objIndex.sectionOfTexCoord(chunk.corners[i + 2]));
+			}
+		}
+
+		/// the elements go after the sentinels in file order
+		PackedRanges positionRanges, normalRanges, texCoordRanges;
+		for (auto&& [section, chunk] : chunks) {
+			positionRanges.add(chunk.positionBase, positions.size(), chunk.positions.size());
+			normalRanges.add(chunk.normalBase, normals.size(), chunk.normals.size());
+			texCoordRanges.add(chunk.texCoordBase, texCoords.size(), chunk.texCoords.size());
+
+			positions.insert(positions.end(), chunk.positions.begin(), chunk.positions.end());
+			normals.insert(normals.end(), chunk.normals.begin(), chunk.normals.end());
+			texCoords.insert(texCoords.end(), chunk.texCoords.begin(), chunk.texCoords.end());
+		}
+
+		for (int section : selected) {
+			ObjChunk& chunk = chunks[section];
+
+			for (size_t i = 0; i < chunk.corners.size(); i += 3) {
+				chunk.corners[i] = positionRanges.toPacked(chunk.corners[i]);
+				chunk.corners[i + 1] = normalRanges.toPacked(chunk.corners[i + 1]);
+				chunk.corners[i + 2] = texCoordRanges.toPacked(chunk.corners[i + 2]);
 			}
 
-			vertexIndex = indexMap[vertexIndexes];
+			/// every mtllib is loaded already
+			chunk.mtlEvents.erase(std::remove_if(chunk.mtlEvents.begin(), chunk.mtlEvents.end(),
+					[] (auto& event) { return event.type == LINE_MTLLIB; }),
+					chunk.mtlEvents.end());
 
-			faces.back().push_back(vertexIndex);
+			const std::string& material = objIndex.sections[section].material;
+			currentMtl = material == "" ? 0 : mtlLoader.getMaterialIndex(material);
+
+			mergeChunkFaces(chunk);
 		}
+
+		notePeaks();
+
+		completeLateVertices();
+
+		mesh.elementIndex = std::move(faces);
+		mesh.materialIndex = std::move(mtlForFace);
+		mesh.triangleIndex = std::move(triangles);
+		mesh.triangleMaterialIndex = std::move(mtlForTriangle);
+		mesh.materials = mtlLoader.materials;
+		mesh.updateRenderMaterials();
+
+		if (groupByMaterial)
+			mesh.groupByMaterial();
+
+		stats.end();
 	}
 };
 
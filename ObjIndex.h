@@ -0,0 +1,150 @@
+#ifndef OBJ_INDEX_H_INCLUDED
+#define OBJ_INDEX_H_INCLUDED
+
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "TextParse.h"
+#include "ObjPrescan.h"
+
+/// byte ranges of the o/g sections of an obj, so a few of them can be parsed
+/// without reading the rest (see OBJLoader::loadObjects)
+///
+/// a section goes from its o/g line to the next one, the lines before the
+/// first o/g are a section named ""; the bases are the v/vn/vt elements
+/// before the section (sentinels included), that is what is needed to
+/// resolve its relative indexes and to find the section an index lives in
+class ObjIndex {
+public:
+	struct Section {
+		std::string name;	/// what follows o/g, as written
+
+		size_t begin = 0;	/// byte offsets in the file
+		size_t end = 0;
+
+		int positionBase = 1;
+		int normalBase = 1;
+		int texCoordBase = 1;
+
+		ObjPrescan::Counts counts;
+
+		std::string material;	/// the usemtl in effect where the section starts
+	};
+
+	std::vector <Section> sections;
+	std::vector <std::string> mtlLibs;	/// every mtllib of the file, in order
+
+	size_t fileSize = 0;	/// of the file that was indexed
+
+	void clear() {
+		sections.clear();
+		mtlLibs.clear();
+		fileSize = 0;
+	}
+
+	/// only the first token of every line is looked at, the counts of each
+	/// section come from ObjPrescan
+	void build (const char *begin, const char *end) {
+		clear();
+		fileSize = end - begin;
+
+		const char *sectionBegin = begin;
+		std::string sectionName = "";
+		std::string sectionMaterial = "";
+		std::string material = "";
+
+		auto closeSection = [&] (const char *sectionEnd) {
+			/// nothing before the first o/g
+			if (sectionBegin == begin && sectionEnd == begin && sectionName == "")
+				return;
+
+			Section section;
+			section.name = sectionName;
+			section.begin = sectionBegin - begin;
+			section.end = sectionEnd - begin;
+			section.counts = ObjPrescan::count(sectionBegin, sectionEnd);
+			section.material = sectionMaterial;
+
+			if (sections.size()) {
+				Section& last = sections.back();
+				section.positionBase = last.positionBase + last.counts.positions;
+				section.normalBase = last.normalBase + last.counts.normals;
+				section.texCoordBase = last.texCoordBase + last.counts.texCoords;
+			}
+
+			sections.push_back(section);
+		};
+
+		forEachLine(begin, end, [&] (const char *lineBegin, const char *lineEnd) {
+			TextCursor line(lineBegin, lineEnd);
+			line.skipBlanks();
+
+			/// most lines are v/vt/vn/f, they are skipped on the first byte
+			if (line.atEnd() || (*line.cur != 'o' && *line.cur != 'g' && *line.cur != 'u' &&
+					*line.cur != 'm'))
+				return;
+
+			std::string_view header = line.nextToken();
+
+			if (header == "o" || header == "g") {
+				closeSection(lineBegin);
+
+				sectionBegin = lineBegin;
+				sectionName = std::string(line.rest());
+				sectionMaterial = material;
+			}
+			else if (header == "usemtl") {
+				material = std::string(line.nextToken());
+			}
+			else if (header == "mtllib") {
+				mtlLibs.push_back(std::string(line.nextToken()));
+			}
+		});
+
+		closeSection(end);
+	}
+
+	/// indexes of the sections with one of the names, in file order
+	std::vector <int> find (const std::vector<std::string>& names) const {
+		std::vector <int> res;
+
+		for (int i = 0; i < sections.size(); i++)
+			if (std::find(names.begin(), names.end(), sections[i].name) != names.end())
+				res.push_back(i);
+
+		return res;
+	}
+
+	/// the section whose v lines hold the element, -1 if the file has no such element
+	int sectionOfPosition (int index) const {
+		return sectionOf(index, &Section::positionBase, &ObjPrescan::Counts::positions);
+	}
+
+	int sectionOfNormal (int index) const {
+		return sectionOf(index, &Section::normalBase, &ObjPrescan::Counts::normals);
+	}
+
+	int sectionOfTexCoord (int index) const {
+		return sectionOf(index, &Section::texCoordBase, &ObjPrescan::Counts::texCoords);
+	}
+
+	int sectionOf (int index, int Section::*base, size_t ObjPrescan::Counts::*count) const {
+		/// the last section starting at or before the index
+		auto it = std::upper_bound(sections.begin(), sections.end(), index,
+				[&] (int value, const Section& section) {
+					return value < section.*base;
+				});
+
+		if (it == sections.begin())
+			return -1;
+
+		const Section& section = *(it - 1);
+		if (index - section.*base >= section.counts.*count)
+			return -1;
+
+		return it - 1 - sections.begin();
+	}
+};
+
+#endif
@@ -0,0 +1,229 @@
+#ifndef OBJ_PRESCAN_H_INCLUDED
+#define OBJ_PRESCAN_H_INCLUDED
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define OBJ_PRESCAN_X86
+#include <immintrin.h>
+#endif
+
+/// counts the records of an obj buffer so every container can be reserved
+/// once; the counts are exact (the same lines OBJLoader::lineType accepts and
+/// the same blank separated tokens TextCursor sees), so they can also be used
+/// as offsets
+///
+/// the buffer is walked 64 bytes at a time, newline and blank bytes become
+/// bit masks (AVX2 or SSE2 compares, picked at runtime, or a scalar loop),
+/// token starts are found with shifts on the masks and only the line starts
+/// are looked at one by one
+class ObjPrescan {
+public:
+	static const int SCALAR = 0;
+	static const int SSE2 = 1;
+	static const int AVX2 = 2;
+
+	struct Counts {
+		size_t positions = 0;
+		size_t normals = 0;
+		size_t texCoords = 0;
+		size_t faces = 0;
+		size_t corners = 0;	/// face vertexes, of all the faces
+		size_t lines = 0;
+	};
+
+	static int bestImpl() {
+#ifdef OBJ_PRESCAN_X86
+		if (__builtin_cpu_supports("avx2"))
+			return AVX2;
+		if (__builtin_cpu_supports("sse2"))
+			return SSE2;
+#endif
+		return SCALAR;
+	}
+
+	static Counts count (const char *begin, const char *end) {
+		return count(begin, end, bestImpl());
+	}
+
+	static Counts count (const char *begin, const char *end, int impl) {
+		Counts counts;
+
+		int lineType = classify(begin, end);
+		size_t lineTokenStart = 0;	/// token starts before the current line
+		size_t tokenStarts = 0;
+		uint64_t prevBlank = 1;		/// the buffer starts like a line does
+
+		auto endLine = [&] (size_t tokensAtEnd) {
+			counts.lines++;
+			addLine(counts, lineType, tokensAtEnd - lineTokenStart);
+		};
+
+		for (const char *block = begin; block < end; block += 64) {
+			uint64_t newline, blank;
+
+			if (end - block >= 64) {
+				masks(block, impl, newline, blank);
+			}
+			else {
+				/// the tail is padded with blanks, they start no tokens
+				char tail[64];
+				memset(tail, ' ', sizeof(tail));
+				memcpy(tail, block, end - block);
+				masks(tail, SCALAR, newline, blank);
+			}
+
+			uint64_t separator = newline | blank;
+			uint64_t starts = ~separator & ((separator << 1) | prevBlank);
+			prevBlank = separator >> 63;
+
+			while (newline) {
+				int bit = __builtin_ctzll(newline);
+				newline &= newline - 1;
+
+				uint64_t before = bit ? (starts & ((1ull << bit) - 1)) : 0;
+				size_t tokensHere = tokenStarts + __builtin_popcountll(before);
+
+				endLine(tokensHere);
+
+				lineTokenStart = tokensHere;
+				lineType = classify(block + bit + 1, end);
+			}
+
+			tokenStarts += __builtin_popcountll(starts);
+		}
+
+		/// last line without a '\n'
+		if (begin < end && end[-1] != '\n')
+			endLine(tokenStarts);
+
+		return counts;
+	}
+
+	static const int LINE_OTHER = 0;
+	static const int LINE_POSITION = 1;
+	static const int LINE_NORMAL = 2;
+	static const int LINE_TEXCOORD = 3;
+	static const int LINE_FACE = 4;
+
+	static bool isBlank (char c) {
+		return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+	}
+
+	static void addLine (Counts& counts, int lineType, size_t tokens) {
+		switch (lineType) {
+			case LINE_POSITION:	counts.positions++;	break;
+			case LINE_NORMAL:	counts.normals++;	break;
+			case LINE_TEXCOORD:	counts.texCoords++;	break;
+			case LINE_FACE:
+				counts.faces++;
+				counts.corners += tokens - 1;	/// the 'f' is a token too
+				break;
+		}
+	}
+
+	/// looks at the first token of the line starting at p
+	static int classify (const char *p, const char *end) {
+		while (p < end && isBlank(*p))
+			p++;
+
+		auto tokenEnds = [&] (const char *q) {
+			return q >= end || *q == '\n' || isBlank(*q);
+		};
+
+		if (p >= end)
+			return LINE_OTHER;
+
+		if (p[0] == 'f' && tokenEnds(p + 1))
+			return LINE_FACE;
+
+		if (p[0] != 'v')
+			return LINE_OTHER;
+
+		if (tokenEnds(p + 1))
+			return LINE_POSITION;
+
+		if (p + 1 < end && tokenEnds(p + 2)) {
+			if (p[1] == 'n')
+				return LINE_NORMAL;
+			if (p[1] == 't')
+				return LINE_TEXCOORD;
+		}
+
+		return LINE_OTHER;
+	}
+
+	/// bit i of newline/blank is set if block[i] is a '\n'/blank
+	static void masks (const char *block, int impl, uint64_t& newline, uint64_t& blank) {
+#ifdef OBJ_PRESCAN_X86
+		if (impl == AVX2) {
+			masksAVX2(block, newline, blank);
+			return;
+		}
+
+		if (impl == SSE2) {
+			masksSSE2(block, newline, blank);
+			return;
+		}
+#endif
+		newline = 0;
+		blank = 0;
+		for (int i = 0; i < 64; i++) {
+			newline |= (uint64_t)(block[i] == '\n') << i;
+			blank |= (uint64_t)isBlank(block[i]) << i;
+		}
+	}
+
+#ifdef OBJ_PRESCAN_X86
+	/// ' ' is 0x20, '\t' '\v' '\f' '\r' are 0x09 0x0b 0x0c 0x0d, '\n' (0x0a)
+	/// is in the middle of them so it is taken out again
+	__attribute__((target("avx2")))
+	static void masksAVX2 (const char *block, uint64_t& newline, uint64_t& blank) {
+		uint64_t res[2][2];
+
+		for (int half = 0; half < 2; half++) {
+			__m256i bytes = _mm256_loadu_si256((const __m256i *)(block + half * 32));
+			__m256i isNewline = _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('\n'));
+			__m256i isSpace = _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(' '));
+
+			/// 0x09 <= c <= 0x0d, done as an unsigned compare on c - 0x09
+			__m256i shifted = _mm256_sub_epi8(bytes, _mm256_set1_epi8(0x09));
+			__m256i inRange = _mm256_cmpeq_epi8(
+					_mm256_min_epu8(shifted, _mm256_set1_epi8(0x04)), shifted);
+
+			__m256i isBlank = _mm256_andnot_si256(isNewline, _mm256_or_si256(isSpace, inRange));
+
+			res[half][0] = (uint32_t)_mm256_movemask_epi8(isNewline);
+			res[half][1] = (uint32_t)_mm256_movemask_epi8(isBlank);
+		}
+
+		newline = res[0][0] | (res[1][0] << 32);
+		blank = res[0][1] | (res[1][1] << 32);
+	}
+
+	__attribute__((target("sse2")))
+	static void masksSSE2 (const char *block, uint64_t& newline, uint64_t& blank) {
+		newline = 0;
+		blank = 0;
+
+		for (int part = 0; part < 4; part++) {
+			__m128i bytes = _mm_loadu_si128((const __m128i *)(block + part * 16));
+			__m128i isNewline = _mm_cmpeq_epi8(bytes, _mm_set1_epi8('\n'));
+			__m128i isSpace = _mm_cmpeq_epi8(bytes, _mm_set1_epi8(' '));
+
+			__m128i shifted = _mm_sub_epi8(bytes, _mm_set1_epi8(0x09));
+			__m128i inRange = _mm_cmpeq_epi8(
+					_mm_min_epu8(shifted, _mm_set1_epi8(0x04)), shifted);
+
+			__m128i isBlank = _mm_andnot_si128(isNewline, _mm_or_si128(isSpace, inRange));
+
+			newline |= (uint64_t)(uint16_t)_mm_movemask_epi8(isNewline) << (part * 16);
+			blank |= (uint64_t)(uint16_t)_mm_movemask_epi8(isBlank) << (part * 16);
+		}
+	}
+#endif
+};
+
+#endif
@@ -0,0 +1,243 @@
+#ifndef TEXT_PARSE_H_INCLUDED
+#define TEXT_PARSE_H_INCLUDED
+
+#include <string>
+#include <string_view>
+#include <cstdlib>
+#include <cstring>
+#include <climits>
+#include <algorithm>
+
+/// walks over a line of text without copying it, tokens are views inside
+/// the original buffer so they are valid only as long as the buffer is
+class TextCursor {
+public:
+	const char *cur;
+	const char *end;
+
+	TextCursor (const char *begin, const char *end) : cur(begin), end(end) {}
+
+	static bool isBlank (char c) {
+		return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+	}
+
+	void skipBlanks() {
+		while (cur < end && isBlank(*cur))
+			cur++;
+	}
+
+	bool atEnd() {
+		skipBlanks();
+		return cur >= end;
+	}
+
+	std::string_view nextToken() {
+		skipBlanks();
+
+		const char *start = cur;
+		while (cur < end && !isBlank(*cur))
+			cur++;
+
+		return std::string_view(start, cur - start);
+	}
+
+	/// the rest of the line, without the blanks around it
+	std::string_view rest() {
+		skipBlanks();
+
+		const char *last = end;
+		while (last > cur && isBlank(*(last - 1)))
+			last--;
+
+		return std::string_view(cur, last - cur);
+	}
+
+	bool nextFloat (float& val) {
+		skipBlanks();
+
+		bool ok = parseFloat(cur, end, val);
+		while (cur < end && !isBlank(*cur))	/// junk after the number
+			cur++;
+
+		return ok;
+	}
+
+	bool nextInt (int& val) {
+		skipBlanks();
+
+		bool ok = parseInt(cur, end, val);
+		while (cur < end && !isBlank(*cur))
+			cur++;
+
+		return ok;
+	}
+
+	static bool toFloat (std::string_view token, float& val) {
+		const char *p = token.data();
+		return parseFloat(p, token.data() + token.size(), val);
+	}
+
+	static bool toInt (std::string_view token, int& val) {
+		const char *p = token.data();
+		return parseInt(p, token.data() + token.size(), val);
+	}
+
+	static bool isDigit (char c) {
+		return c >= '0' && c <= '9';
+	}
+
+	/// [+-]digits, p is left after the last digit; values too big for an
+	/// int are clamped to +-INT_MAX
+	static bool parseInt (const char *&p, const char *end, int& val) {
+		const char *s = p;
+		bool negative = false;
+
+		if (s < end && (*s == '-' || *s == '+'))
+			negative = (*s++ == '-');
+
+		if (s >= end || !isDigit(*s))
+			return false;
+
+		long long res = 0;
+		while (s < end && isDigit(*s)) {
+			res = std::min<long long>(res * 10 + (*s - '0'), INT_MAX);
+			s++;
+		}
+
+		val = negative ? -res : res;
+		p = s;
+		return true;
+	}
+
+	/// [+-]digits[.digits][(e|E)[+-]digits], p is left after the number
+	///
+	/// mantissas that fit in 53 bits with small exponents are computed
+	/// exactly in double and rounded once to float, everything else (long
+	/// mantissas, huge exponents, inf, nan, results that land on a tie
+	/// between two floats) goes to strtof, so the result is the same as
+	/// strtof's for decimal numbers; hex floats are not read (0x1p3 is 0)
+	static bool parseFloat (const char *&p, const char *end, float& val) {
+		const char *s = p;
+		bool negative = false;
+
+		if (s < end && (*s == '-' || *s == '+'))
+			negative = (*s++ == '-');
+
+		unsigned long long mantissa = 0;
+		int digitCount = 0;
+		int exponent = 0;
+		bool anyDigit = false;
+
+		while (s < end && isDigit(*s)) {
+			if (mantissa != 0 || *s != '0')
+				digitCount++;
+			mantissa = mantissa * 10 + (*s - '0');
+			anyDigit = true;
+			s++;
+
+			if (digitCount > 19)
+				return parseFloatSlow(p, end, val);
+		}
+
+		if (s < end && *s == '.') {
+			s++;
+			while (s < end && isDigit(*s)) {
+				if (mantissa != 0 || *s != '0')
+					digitCount++;
+				mantissa = mantissa * 10 + (*s - '0');
+				exponent--;
+				anyDigit = true;
+				s++;
+
+				if (digitCount > 19)
+					return parseFloatSlow(p, end, val);
+			}
+		}
+
+		if (!anyDigit)
+			return parseFloatSlow(p, end, val);	/// inf, nan or not a number
+
+		if (s < end && (*s == 'e' || *s == 'E')) {
+			const char *expStart = s + 1;
+			int expValue = 0;
+
+			/// saturated, anything past it is 0 or inf for strtof anyway
+			if (parseInt(expStart, end, expValue)) {
+				long long sum = (long long)exponent + expValue;
+				exponent = std::max(-100000ll, std::min(100000ll, sum));
+				s = expStart;
+			}
+		}
+
+		static const double pow10[] = {
+			1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+			1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+		};
+
+		if (mantissa > (1ull << 53) || exponent < -22 || exponent > 22)
+			return parseFloatSlow(p, end, val);
+
+		double res = mantissa;
+		if (exponent < 0)
+			res /= pow10[-exponent];
+		else
+			res *= pow10[exponent];
+
+		if (res != 0 && (res < 1.17549435e-38 || res > 3.40282346e+38))
+			return parseFloatSlow(p, end, val);	/// subnormal or out of range
+
+		/// the double is exactly half way between two floats, the decimal
+		/// could be on either side of it
+		unsigned long long bits;
+		memcpy(&bits, &res, sizeof(bits));
+		if ((bits & ((1ull << 29) - 1)) == (1ull << 28))
+			return parseFloatSlow(p, end, val);
+
+		val = negative ? -(float)res : (float)res;
+		p = s;
+		return true;
+	}
+
+	/// strtof on a copy of the token, on the heap if it's too long for the stack
+	static bool parseFloatSlow (const char *&p, const char *end, float& val) {
+		size_t len = 0;
+		while (p + len < end && !isBlank(p[len]) && p[len] != '/')
+			len++;
+
+		char stackBuff[64];
+		std::string heapBuff;
+		char *buff = stackBuff;
+		if (len >= sizeof(stackBuff)) {
+			heapBuff.resize(len + 1);
+			buff = &heapBuff[0];
+		}
+
+		memcpy(buff, p, len);
+		buff[len] = '\0';
+
+		char *last = nullptr;
+		float res = strtof(buff, &last);
+		if (last == buff)
+			return false;
+
+		val = res;
+		p += last - buff;
+		return true;
+	}
+};
+
+/// calls func(lineBegin, lineEnd) for every line in [begin, end), the
+/// '\n' is not part of the line
+template <typename FuncType>
+void forEachLine (const char *begin, const char *end, FuncType&& func) {
+	while (begin < end) {
+		const char *lineEnd = (const char *)memchr(begin, '\n', end - begin);
+		if (lineEnd == nullptr)
+			lineEnd = end;
+
+		func(begin, lineEnd);
+		begin = lineEnd + 1;
+	}
+}
+
+#endif
@@ -0,0 +1,458 @@
+#ifndef TEXTURE_ATLAS_H_INCLUDED
+#define TEXTURE_ATLAS_H_INCLUDED
+
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <cstring>
+
+#include "Mesh.h"
+
+/// places rectangles in a page of width x height, bottom left first, only
+/// keeping the top edge of what was placed (the skyline), so the gaps under
+/// it are lost but a placement is O(skyline size)
+class SkylinePacker {
+public:
+	struct Node {
+		int x;
+		int y;
+		int width;
+	};
+
+	int width;
+	int height;
+	std::vector <Node> skyline;
+
+	SkylinePacker (int width, int height) : width(width), height(height) {
+		skyline.push_back(Node{0, 0, width});
+	}
+
+	/// false if the rectangle doesn't fit anymore
+	bool insert (int rectWidth, int rectHeight, int& x, int& y) {
+		int best = -1;
+		int bestTop = height + 1;
+		int bestWidth = width + 1;
+
+		for (int i = 0; i < skyline.size(); i++) {
+			int top;
+			if (!fit(i, rectWidth, rectHeight, top))
+				continue;
+
+			if (top < bestTop || (top == bestTop && skyline[i].width < bestWidth)) {
+				best = i;
+				bestTop = top;
+				bestWidth = skyline[i].width;
+			}
+		}
+
+		if (best < 0)
+			return false;
+
+		x = skyline[best].x;
+		y = bestTop - rectHeight;
+		place(best, rectWidth, bestTop);
+
+		return true;
+	}
+
+	/// top of the rectangle if its left side is on node i
+	bool fit (int i, int rectWidth, int rectHeight, int& top) {
+		int x = skyline[i].x;
+		if (x + rectWidth > width)
+			return false;
+
+		int y = 0;
+		for (int left = rectWidth; left > 0; i++) {
+			y = std::max(y, skyline[i].y);
+			left -= skyline[i].width;
+		}
+
+		top = y + rectHeight;
+		return top <= height;
+	}
+
+	void place (int i, int rectWidth, int top) {
+		int x = skyline[i].x;
+		skyline.insert(skyline.begin() + i, Node{x, top, rectWidth});
+
+		/// the nodes under the rectangle get shorter or go away
+		for (int j = i + 1; j < skyline.size(); ) {
+			int shrink = x + rectWidth - skyline[j].x;
+			if (shrink <= 0)
+				break;
+
+			if (shrink < skyline[j].width) {
+				skyline[j].x += shrink;
+				skyline[j].width -= shrink;
+				break;
+			}
+
+			skyline.erase(skyline.begin() + j);
+		}
+
+		for (int j = 0; j + 1 < skyline.size(); ) {
+			if (skyline[j].y == skyline[j + 1].y) {
+				skyline[j].width += skyline[j + 1].width;
+				skyline.erase(skyline.begin() + j + 1);
+			}
+			else {
+				j++;
+			}
+		}
+	}
+};
+
+/// packs the diffuse textures of a mesh in one or a few pages, so materials
+/// that only differ by their diffuse map bind the same texture: the images
+/// are read back from gl, placed with a SkylinePacker with padding pixels
+/// copied from their edges, and the texture coordinates of the vertexes are
+/// moved in the pages, vertexes used by faces that end up in different
+/// places are duplicated
+///
+/// materials whose faces have texture coordinates outside [0, 1] repeat
+/// their texture and keep it, so do images bigger than a page
+///
+/// materials left with nothing different but their name are merged: their
+/// faces take the first one, so the drawers switch material once per page
+/// (the others stay in materials, unused); lazy diffuse textures are loaded
+/// first since the images are read from gl
+///
+/// build needs the gl context; the pages belong to the atlas, keep it alive
+/// as long as the mesh is drawn
+class TextureAtlas {
+public:
+	int pageSize = 4096;
+
+	/// pixels of edge around each image; the pages only get the mip levels
+	/// whose texels fit in it (level k spans 2^k pixels) so the images don't
+	/// bleed into each other, 1 level past the base with the default
+	int padding = 2;
+
+	std::vector <Texture> pages;
+
+	TextureAtlas() {}
+
+	TextureAtlas (const TextureAtlas& other) = delete;
+	TextureAtlas& operator = (const TextureAtlas& other) = delete;
+
+	~TextureAtlas() {
+		clear();
+	}
+
+	void clear() {
+		for (auto&& page : pages)
+			glDeleteTextures(1, (GLuint*)&page.openglTexture);
+
+		pages.clear();
+	}
+
+	/// an image placed in a page
+	struct Placement {
+		unsigned int texture;	/// the gl texture it was read from
+		int width;
+		int height;
+		std::vector <unsigned char> pixels;
+
+		int page = -1;
+		int x = 0;		/// of the image, without the padding
+		int y = 0;
+	};
+
+	template <typename VertexType>
+	void build (Mesh<VertexType>& mesh) {
+		if (mesh.renderMaterials.size() != mesh.materials.size())
+			mesh.updateRenderMaterials();
+
+		for (int i = 0; i < mesh.materials.size(); i++)
+			mesh.getRenderMaterial(i, 1u << MaterialRenderData::DIFUSE);
+
+		/// which placement each material uses, -1 if it keeps its texture
+		std::vector <int> placementOf(mesh.materials.size(), -1);
+		std::vector <bool> repeats = findRepeats(mesh);
+		std::vector <Placement> placements;
+		std::map <unsigned int, int> placementOfTexture;
+
+		for (int i = 0; i < mesh.materials.size(); i++) {
+			unsigned int texture = mesh.materials[i].difuseTexture.openglTexture;
+			if (texture == 0 || repeats[i])
+				continue;
+
+			auto it = placementOfTexture.find(texture);
+			if (it == placementOfTexture.end()) {
+				Placement placement;
+				placement.texture = texture;
+				if (!readPixels(placement))
+					continue;
+
+				it = placementOfTexture.emplace(texture, placements.size()).first;
+				placements.push_back(std::move(placement));
+			}
+
+			placementOf[i] = it->second;
+		}
+
+		pack(placements);
+
+		for (auto&& placementIndex : placementOf)
+			if (placementIndex >= 0 && placements[placementIndex].page < 0)
+				placementIndex = -1;
+
+		int firstPage = pages.size();
+		int pageCount = 0;
+		for (auto&& placement : placements)
+			pageCount = std::max(pageCount, placement.page + 1);
+
+		for (int page = 0; page < pageCount; page++)
+			pages.push_back(upload(placements, page));
+
+		remapTexCoords(mesh, placementOf, placements);
+
+		for (int i = 0; i < mesh.materials.size(); i++)
+			if (placementOf[i] >= 0)
+				mesh.materials[i].difuseTexture = pages[firstPage + placements[placementOf[i]].page];
+
+		mergeMaterials(mesh, placementOf);
+		mesh.updateRenderMaterials();
+	}
+
+	/// faces of materials that now only differ by their name take the first
+	/// of them, the mesh is grouped again if it was
+	template <typename VertexType>
+	static void mergeMaterials (Mesh<VertexType>& mesh, const std::vector<int>& placementOf) {
+		std::vector <int> mergedInto(mesh.materials.size());
+		bool merged = false;
+
+		for (int i = 0; i < mesh.materials.size(); i++) {
+			mergedInto[i] = i;
+			if (placementOf[i] < 0)
+				continue;
+
+			for (int j = 0; j < i; j++) {
+				if (mergedInto[j] == j && placementOf[j] >= 0 &&
+						sameLook(mesh.materials[i], mesh.materials[j]))
+				{
+					mergedInto[i] = j;
+					merged = true;
+					break;
+				}
+			}
+		}
+
+		if (!merged)
+			return;
+
+		auto remap = [&] (std::vector<int>& materialOf) {
+			for (auto&& material : materialOf)
+				if (material >= 0 && material < mergedInto.size())
+					material = mergedInto[material];
+		};
+		remap(mesh.materialIndex);
+		remap(mesh.triangleMaterialIndex);
+
+		if (mesh.subMeshes.size() != 0)
+			mesh.groupByMaterial();
+	}
+
+	/// same colors and textures, the diffuse map is compared by texture only
+	/// since the paths of packed images differ
+	static bool sameLook (const Material& a, const Material& b) {
+		auto textures = [] (const Material& material) {
+			std::vector <std::pair<unsigned int, std::string>> result;
+			MTLLoader::forEachTexture(material, [&] (const Texture& texture, const std::string& path) {
+				result.emplace_back(texture.openglTexture, path);
+			});
+			result[MaterialRenderData::DIFUSE].second = "";
+			return result;
+		};
+
+		return memcmp(&a.ambientColor, &b.ambientColor, sizeof(Math::Point4f)) == 0 &&
+				memcmp(&a.difuseColor, &b.difuseColor, sizeof(Math::Point4f)) == 0 &&
+				memcmp(&a.specularColor, &b.specularColor, sizeof(Math::Point4f)) == 0 &&
+				a.specularWeight == b.specularWeight && textures(a) == textures(b);
+	}
+
+	/// calls func(vertexIndex, material) for every corner of every face
+	template <typename VertexType, typename FuncType>
+	static void forEachCorner (Mesh<VertexType>& mesh, FuncType&& func) {
+		for (int i = 0; i < mesh.elementIndex.size(); i++) {
+			int material = i < mesh.materialIndex.size() ? mesh.materialIndex[i] : -1;
+			for (auto&& index : mesh.elementIndex[i])
+				func(index, material);
+		}
+
+		for (int i = 0; i < mesh.triangleIndex.size(); i++) {
+			int triangle = i / 3;
+			int material = triangle < mesh.triangleMaterialIndex.size() ?
+					mesh.triangleMaterialIndex[triangle] : -1;
+			func(mesh.triangleIndex[i], material);
+		}
+	}
+
+	/// materials with texture coordinates outside [0, 1]
+	template <typename VertexType>
+	static std::vector<bool> findRepeats (Mesh<VertexType>& mesh) {
+		std::vector <bool> repeats(mesh.materials.size(), false);
+		const float EPS = 1e-4;
+
+		forEachCorner(mesh, [&] (int& index, int material) {
+			if (material < 0 || material >= repeats.size())
+				return;
+
+			mesh.vertexList[index].template useIfExists<VertexTexCoord>([&] (auto& texCoord) {
+				const float *uv = texCoord.getPtr();
+				if (uv[0] < -EPS || uv[0] > 1 + EPS || uv[1] < -EPS || uv[1] > 1 + EPS)
+					repeats[material] = true;
+			});
+		});
+
+		return repeats;
+	}
+
+	static bool readPixels (Placement& placement) {
+		glBindTexture(GL_TEXTURE_2D, placement.texture);
+
+		GLint width = 0;
+		GLint height = 0;
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+
+		if (width <= 0 || height <= 0)
+			return false;
+
+		placement.width = width;
+		placement.height = height;
+		placement.pixels.resize((size_t)width * height * 4);
+
+		glPixelStorei(GL_PACK_ALIGNMENT, 1);
+		glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, placement.pixels.data());
+
+		return true;
+	}
+
+	/// tallest first, each in the first page it fits in; images bigger
+	/// than a page keep page -1
+	void pack (std::vector<Placement>& placements) {
+		std::vector <int> order(placements.size());
+		for (int i = 0; i < order.size(); i++)
+			order[i] = i;
+
+		std::stable_sort(order.begin(), order.end(), [&] (int a, int b) {
+			return placements[a].height > placements[b].height;
+		});
+
+		std::vector <SkylinePacker> packers;
+		for (int i : order) {
+			Placement& placement = placements[i];
+			int width = placement.width + 2 * padding;
+			int height = placement.height + 2 * padding;
+
+			if (width > pageSize || height > pageSize)
+				continue;
+
+			int x, y;
+			for (int page = 0; page <= packers.size(); page++) {
+				if (page == packers.size())
+					packers.emplace_back(pageSize, pageSize);
+
+				if (packers[page].insert(width, height, x, y)) {
+					placement.page = page;
+					placement.x = x + padding;
+					placement.y = y + padding;
+					break;
+				}
+			}
+		}
+	}
+
+	/// copies the images of the page in it, the padding repeats their edges
+	Texture upload (const std::vector<Placement>& placements, int page) {
+		std::vector <unsigned char> pixels((size_t)pageSize * pageSize * 4, 0);
+
+		for (auto&& placement : placements) {
+			if (placement.page != page)
+				continue;
+
+			for (int y = -padding; y < placement.height + padding; y++) {
+				int sourceY = std::min(std::max(y, 0), placement.height - 1);
+
+				for (int x = -padding; x < placement.width + padding; x++) {
+					int sourceX = std::min(std::max(x, 0), placement.width - 1);
+
+					size_t source = ((size_t)sourceY * placement.width + sourceX) * 4;
+					size_t target = ((size_t)(placement.y + y) * pageSize + placement.x + x) * 4;
+					memcpy(&pixels[target], &placement.pixels[source], 4);
+				}
+			}
+		}
+
+		Texture texture;
+		glGenTextures(1, (GLuint*)&texture.openglTexture);
+		glBindTexture(GL_TEXTURE_2D, texture.openglTexture);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, pageSize, pageSize, 0, GL_RGBA,
+				GL_UNSIGNED_BYTE, pixels.data());
+
+		int maxLevel = 0;
+		while ((2 << maxLevel) <= padding)
+			maxLevel++;
+
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, maxLevel);
+		glGenerateMipmap(GL_TEXTURE_2D);
+
+		return texture;
+	}
+
+	/// every vertex gets the coordinates of the first placement that uses
+	/// it, the other placements (or -1, the original texture) get a copy
+	template <typename VertexType>
+	void remapTexCoords (Mesh<VertexType>& mesh, const std::vector<int>& placementOf,
+			const std::vector<Placement>& placements)
+	{
+		const int UNUSED = -2;
+		std::vector <int> placementOfVertex(mesh.vertexList.size(), UNUSED);
+		std::map <std::pair<int, int>, int> copies;
+
+		size_t originalCount = mesh.vertexList.size();
+		std::vector <VertexType> originals = mesh.vertexList;
+
+		auto move = [&] (VertexType& vertex, int placementIndex) {
+			if (placementIndex < 0)
+				return;
+
+			const Placement& placement = placements[placementIndex];
+			vertex.template useIfExists<VertexTexCoord>([&] (auto& texCoord) {
+				float *uv = texCoord.getPtr();
+				uv[0] = (placement.x + uv[0] * placement.width) / pageSize;
+				uv[1] = (placement.y + uv[1] * placement.height) / pageSize;
+			});
+		};
+
+		forEachCorner(mesh, [&] (int& index, int material) {
+			if (index < 0 || index >= originalCount)
+				return;
+
+			int placementIndex = material >= 0 && material < placementOf.size() ?
+					placementOf[material] : -1;
+
+			if (placementOfVertex[index] == UNUSED) {
+				placementOfVertex[index] = placementIndex;
+				move(mesh.vertexList[index], placementIndex);
+			}
+			else if (placementOfVertex[index] != placementIndex) {
+				auto it = copies.find({index, placementIndex});
+				if (it == copies.end()) {
+					it = copies.emplace(std::make_pair(index, placementIndex),
+							mesh.vertexList.size()).first;
+					mesh.vertexList.push_back(originals[index]);
+					move(mesh.vertexList.back(), placementIndex);
+				}
+
+				index = it->second;
+			}
+		});
+	}
+};
+
+#endif
@@ -0,0 +1,366 @@
+#ifndef TEXTURE_CACHE_H_INCLUDED
+#define TEXTURE_CACHE_H_INCLUDED
+
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <future>
+#include <functional>
+#include <memory>
+#include <iostream>
+#include <cstdio>
+#include <cstdint>
+
+#include "TextureLoader.h"
+#include "TextureDiskCache.h"
+
+/// an image read (and decoded, with a decoder) off the gl thread, waiting
+/// for its upload
+class DecodedImage {
+public:
+	std::string path;
+	std::string key;	/// TextureCache::contentKey of the file
+
+	/// rgba8 pixels, empty if the decoder left the image to TextureLoader
+	int width = 0;
+	int height = 0;
+	std::vector <unsigned char> pixels;
+
+	/// the levels of a TextureDiskCache file, set instead of the pixels
+	std::shared_ptr <TextureDiskCache::Image> cached;
+};
+
+/// every image loaded once, for all the materials and all the loaders: a
+/// path is looked up first, then the content of its file, so copies of an
+/// image under other names share the texture too
+///
+/// each acquire is a reference, the gl texture is deleted when the last one
+/// is released (Mesh does it for its materials); both need the gl context,
+/// call them on its thread
+///
+/// loading is in two stages: decode, from any thread, reads the file on a
+/// pool of threadCount workers, then acquire uploads what was decoded; with
+/// useDiskCache nothing is decoded for an image that has a TextureDiskCache
+/// file
+///
+/// no image decoder comes with the cache: without one the workers only hash
+/// the file (which leaves it in the os cache) and TextureLoader still decodes
+/// it on the gl thread in acquire; set decoder to one that fills the pixels
+/// to move the whole decode off the gl thread
+class TextureCache {
+public:
+	class Entry {
+	public:
+		Texture texture;
+		int references = 0;
+	};
+
+	std::mutex mutex;
+
+	/// content key of each path seen, kept after the release so a path is
+	/// hashed once
+	std::map <std::string, std::string> keyOfPath;
+	std::map <std::string, Entry> entries;
+
+	/// fills the pixels of the image (path is set), runs on the workers
+	std::function <void (DecodedImage&)> decoder;
+
+	class Pending {
+	public:
+		std::shared_future <DecodedImage> future;
+		uint64_t serial;
+	};
+
+	/// decodes waiting for their acquire, by path, and their paths in the
+	/// order they were started; past maxPending the oldest are dropped (a
+	/// prefetch that is never drawn) and decoded again if they are acquired
+	std::map <std::string, Pending> decoding;
+	std::map <uint64_t, std::string> decodingOrder;
+	uint64_t nextSerial = 0;
+	int maxPending = 64;
+
+	int threadCount = 0;	/// decode workers, 0 means one per core
+
+	/// images are read from TextureDiskCache files, and the files are
+	/// written for the images that don't have one yet
+	bool useDiskCache = false;
+
+	/// content keys whose TextureDiskCache file couldn't be written
+	std::set <std::string> unwritable;
+
+	std::deque <std::function<void ()>> queue;
+	std::vector <std::thread> workers;
+	std::condition_variable wake;
+	bool stopping = false;
+
+	~TextureCache() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		wake.notify_all();
+
+		for (auto&& worker : workers)
+			worker.join();
+	}
+
+	/// the cache of MTLLoader and MtlLibrary
+	static TextureCache& shared() {
+		static TextureCache cache;
+		return cache;
+	}
+
+	/// starts decoding the image of path if it's not loaded or decoding, the
+	/// future is not valid if there is nothing to decode
+	std::shared_future<DecodedImage> decode (const std::string& path) {
+		std::lock_guard<std::mutex> lock(mutex);
+
+		auto it = decoding.find(path);
+		if (it != decoding.end())
+			return it->second.future;
+
+		auto key = keyOfPath.find(path);
+		if (key != keyOfPath.end() && entries.count(key->second))
+			return std::shared_future<DecodedImage>();
+
+		auto task = std::make_shared<std::packaged_task<DecodedImage ()>>([this, path] {
+			return decodeImage(path, contentKey(path));
+		});
+
+		std::shared_future<DecodedImage> future = task->get_future().share();
+		decoding[path] = Pending{future, nextSerial};
+		decodingOrder[nextSerial++] = path;
+		queue.push_back([task] { (*task)(); });
+
+		while (decoding.size() > (size_t)std::max(maxPending, 1))
+			eraseDecoding(decoding.find(decodingOrder.begin()->second));
+
+		int count = threadCount > 0 ? threadCount : std::thread::hardware_concurrency();
+		if ((int)workers.size() < std::max(count, 1))
+			workers.emplace_back([this] { work(); });
+		wake.notify_one();
+
+		return future;
+	}
+
+	/// the texture of path, uploading its decoded image or loading it here
+	/// if it was never decoded; files are read and decoded with the mutex
+	/// unlocked, only the gl thread adds entries so nothing loads the same
+	/// image meanwhile
+	Texture acquire (const std::string& path) {
+		std::unique_lock<std::mutex> lock(mutex);
+
+		DecodedImage image;
+		bool decoded = false;
+
+		auto pending = decoding.find(path);
+		if (pending != decoding.end()) {
+			std::shared_future<DecodedImage> future = pending->second.future;
+			eraseDecoding(pending);
+
+			lock.unlock();
+			try {
+				image = future.get();
+			}
+			catch (...) {
+				image.path = path;		/// TextureLoader will say what's wrong
+				image.key = contentKey(path);
+			}
+			lock.lock();
+
+			keyOfPath.emplace(path, image.key);
+			decoded = true;
+		}
+		else if (!keyOfPath.count(path)) {
+			lock.unlock();
+			std::string key = contentKey(path);
+			lock.lock();
+
+			keyOfPath.emplace(path, key);
+		}
+
+		std::string key = keyOfPath[path];
+		auto entry = entries.find(key);
+		if (entry == entries.end()) {
+			lock.unlock();
+			if (!decoded)
+				image = decodeImage(path, key);
+
+			Entry loaded;
+			loaded.texture = upload(image);
+			lock.lock();
+
+			entry = entries.emplace(key, loaded).first;
+		}
+
+		/// a failed load stays in entries so it's not tried again, but there
+		/// is nothing to release for it
+		if (entry->second.texture.openglTexture != 0)
+			entry->second.references++;
+		return entry->second.texture;
+	}
+
+	void eraseDecoding (std::map<std::string, Pending>::iterator it) {
+		decodingOrder.erase(it->second.serial);
+		decoding.erase(it);
+	}
+
+	/// one more reference on a path that is loaded
+	void retain (const std::string& path) {
+		std::lock_guard<std::mutex> lock(mutex);
+
+		auto key = keyOfPath.find(path);
+		if (key == keyOfPath.end())
+			return;
+
+		auto entry = entries.find(key->second);
+		if (entry != entries.end() && entry->second.references > 0)
+			entry->second.references++;
+	}
+
+	/// cpu side of the load: the disk cache if it has the image, else the decoder
+	DecodedImage decodeImage (const std::string& path, const std::string& key) {
+		DecodedImage image;
+		image.path = path;
+		image.key = key;
+
+		if (useDiskCache) {
+			auto cached = std::make_shared<TextureDiskCache::Image>();
+			if (TextureDiskCache::read(path, key, *cached)) {
+				image.cached = cached;
+				return image;
+			}
+		}
+
+		if (decoder)
+			decoder(image);
+
+		return image;
+	}
+
+	/// gl side of the load, called without the mutex
+	Texture upload (const DecodedImage& image) {
+		if (image.cached)
+			return TextureDiskCache::upload(*image.cached);
+
+		Texture texture = uploadPixels(image);
+		if (useDiskCache && texture.openglTexture != 0)
+			writeDiskCache(image, texture);
+
+		return texture;
+	}
+
+	/// from the decoded pixels if there are some, else read back from the
+	/// texture; a file that can't be written is reported and not tried again
+	void writeDiskCache (const DecodedImage& image, const Texture& texture) {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (unwritable.count(image.key))
+				return;
+		}
+
+		bool written = image.pixels.empty() ?
+				TextureDiskCache::write(image.path, image.key, texture.openglTexture) :
+				TextureDiskCache::write(image.path, image.key, image.width, image.height,
+						image.pixels.data());
+
+		if (!written) {
+			std::cerr << "can't write the texture cache of " << image.path << std::endl;
+
+			std::lock_guard<std::mutex> lock(mutex);
+			unwritable.insert(image.key);
+		}
+	}
+
+	static Texture uploadPixels (const DecodedImage& image) {
+		if (image.pixels.empty())
+			return TextureLoader::load(image.path);
+
+		Texture texture;
+		glGenTextures(1, (GLuint*)&texture.openglTexture);
+		glBindTexture(GL_TEXTURE_2D, texture.openglTexture);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, image.width, image.height, 0, GL_RGBA,
+				GL_UNSIGNED_BYTE, image.pixels.data());
+		glGenerateMipmap(GL_TEXTURE_2D);
+
+		return texture;
+	}
+
+	void work() {
+		std::unique_lock<std::mutex> lock(mutex);
+
+		while (true) {
+			wake.wait(lock, [this] { return stopping || !queue.empty(); });
+			if (stopping)
+				return;
+
+			std::function<void ()> job = std::move(queue.front());
+			queue.pop_front();
+
+			lock.unlock();
+			job();
+			lock.lock();
+		}
+	}
+
+	void release (const std::string& path) {
+		std::lock_guard<std::mutex> lock(mutex);
+
+		auto key = keyOfPath.find(path);
+		if (key == keyOfPath.end())
+			return;
+
+		auto entry = entries.find(key->second);
+		if (entry == entries.end() || entry->second.references == 0)
+			return;
+
+		if (--entry->second.references == 0) {
+			glDeleteTextures(1, (GLuint*)&entry->second.texture.openglTexture);
+			entries.erase(entry);
+		}
+	}
+
+	/// 0 if the path is not loaded
+	int references (const std::string& path) {
+		std::lock_guard<std::mutex> lock(mutex);
+
+		auto key = keyOfPath.find(path);
+		if (key == keyOfPath.end())
+			return 0;
+
+		auto entry = entries.find(key->second);
+		return entry == entries.end() ? 0 : entry->second.references;
+	}
+
+	/// size and fnv-1a hash of the file, the path itself if it can't be read
+	/// (the texture loader will say what's wrong with it)
+	static std::string contentKey (const std::string& path) {
+		FILE *file = fopen(path.c_str(), "rb");
+		if (!file)
+			return "path " + path;
+
+		uint64_t hash = 14695981039346656037ull;
+		uint64_t size = 0;
+
+		unsigned char buff[1 << 16];
+		size_t count;
+		while ((count = fread(buff, 1, sizeof(buff), file)) > 0) {
+			for (size_t i = 0; i < count; i++)
+				hash = (hash ^ buff[i]) * 1099511628211ull;
+			size += count;
+		}
+		fclose(file);
+
+		return "content " + std::to_string(size) + " " + std::to_string(hash);
+	}
+};
+
+#endif
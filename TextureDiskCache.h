@@ -0,0 +1,278 @@
+#ifndef TEXTURE_DISK_CACHE_H_INCLUDED
+#define TEXTURE_DISK_CACHE_H_INCLUDED
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+
+#include "TextureLoader.h"
+#include "MappedFile.h"
+#include "BinaryFile.h"
+
+/// pre-decoded images (.texbin next to the image), written once an image
+/// is loaded, from its decoded pixels or read back from its gl texture, and
+/// read back instead of decoding it again; the cache is only used if the key
+/// of the image is the same (its size and hash, see TextureCache::contentKey)
+///
+/// rgba8 images keep every mip level down to 1x1, compressed ones the levels
+/// the texture had on the gpu in its format, so a read is a mapping of the
+/// file and the upload takes the levels straight from it
+///
+/// layout (native endianess, no padding):
+///		header: magic, version, key, format (0 for rgba8, else the gl
+///				compressed internal format), level count
+///		levels: width, height, size, offset of the data in the file
+///		data of the levels
+class TextureDiskCache {
+public:
+	static const uint32_t MAGIC = 0x4e425854;	/// "TXBN"
+	static const uint32_t VERSION = 1;
+
+	/// biggest width or height read back, beyond any gl implementation
+	static const uint64_t MAX_SIZE = 1 << 16;
+
+	struct Level {
+		uint64_t width;
+		uint64_t height;
+		uint64_t size;
+		uint64_t offset;
+	};
+
+	/// a cache file mapped by read
+	class Image {
+	public:
+		MappedFile file;
+		uint64_t format = 0;
+		std::vector <Level> levels;
+
+		const char *data (const Level& level) const {
+			return file.begin() + level.offset;
+		}
+	};
+
+	static std::string cachePath (std::string sourcePath) {
+		return sourcePath + ".texbin";
+	}
+
+	/// level 0 of an rgba8 image, the smaller levels are made from it with
+	/// a box filter; can be called from any thread
+	static bool write (std::string sourcePath, std::string key, uint64_t width, uint64_t height,
+			const unsigned char *pixels)
+	{
+		if (width == 0 || height == 0)
+			return false;
+
+		std::vector <Level> levels;
+		std::vector <std::vector<char>> data;
+
+		data.emplace_back((const char *)pixels, (const char *)pixels + width * height * 4);
+		levels.push_back(Level{width, height, data.back().size(), 0});
+
+		while (levels.back().width > 1 || levels.back().height > 1) {
+			const Level& above = levels.back();
+			data.push_back(halve(data.back(), above.width, above.height));
+			levels.push_back(Level{std::max<uint64_t>(above.width / 2, 1),
+					std::max<uint64_t>(above.height / 2, 1), data.back().size(), 0});
+		}
+
+		return writeLevels(sourcePath, key, 0, levels, data);
+	}
+
+	/// reads texture back from gl without changing it: level 0 if it's
+	/// rgba8 (the others are made as above), the levels it has if it's
+	/// compressed; call it on the gl thread
+	static bool write (std::string sourcePath, std::string key, unsigned int texture) {
+		if (texture == 0)
+			return false;
+
+		glBindTexture(GL_TEXTURE_2D, texture);
+
+		GLint width = 0;
+		GLint height = 0;
+		GLint compressed = 0;
+		GLint format = 0;
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_COMPRESSED, &compressed);
+		if (compressed)
+			glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_INTERNAL_FORMAT, &format);
+
+		if (width <= 0 || height <= 0)
+			return false;
+
+		glPixelStorei(GL_PACK_ALIGNMENT, 1);
+
+		if (!compressed) {
+			std::vector <unsigned char> pixels((size_t)width * height * 4);
+			glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+
+			return write(sourcePath, key, width, height, pixels.data());
+		}
+
+		std::vector <Level> levels;
+		std::vector <std::vector<char>> data;
+
+		for (int level = 0; ; level++) {
+			uint64_t levelWidth = std::max(width >> level, 1);
+			uint64_t levelHeight = std::max(height >> level, 1);
+
+			GLint present = 0;
+			GLint size = 0;
+			glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_WIDTH, &present);
+			glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &size);
+			if (present <= 0 || size <= 0)
+				break;
+
+			std::vector <char> pixels(size);
+			glGetCompressedTexImage(GL_TEXTURE_2D, level, pixels.data());
+
+			levels.push_back(Level{levelWidth, levelHeight, pixels.size(), 0});
+			data.push_back(std::move(pixels));
+
+			if (levelWidth == 1 && levelHeight == 1)
+				break;
+		}
+
+		if (levels.empty())
+			return false;
+
+		return writeLevels(sourcePath, key, format, levels, data);
+	}
+
+	/// the next mip level of an rgba8 image, each pixel the average of the
+	/// 2x2 it covers (2x1 or 1x2 once a side is 1)
+	static std::vector<char> halve (const std::vector<char>& pixels, uint64_t width,
+			uint64_t height)
+	{
+		uint64_t halfWidth = std::max<uint64_t>(width / 2, 1);
+		uint64_t halfHeight = std::max<uint64_t>(height / 2, 1);
+		uint64_t stepX = width > 1 ? 1 : 0;
+		uint64_t stepY = height > 1 ? 1 : 0;
+
+		const unsigned char *source = (const unsigned char *)pixels.data();
+		std::vector <char> result(halfWidth * halfHeight * 4);
+
+		for (uint64_t y = 0; y < halfHeight; y++) {
+			const unsigned char *row = source + 2 * y * width * 4;
+			const unsigned char *next = row + stepY * width * 4;
+
+			for (uint64_t x = 0; x < halfWidth; x++) {
+				uint64_t left = 2 * x * 4;
+				uint64_t right = left + stepX * 4;
+
+				for (int c = 0; c < 4; c++) {
+					unsigned int sum = row[left + c] + row[right + c] + next[left + c] +
+							next[right + c];
+					result[(y * halfWidth + x) * 4 + c] = (sum + 2) / 4;
+				}
+			}
+		}
+
+		return result;
+	}
+
+	static bool writeLevels (std::string sourcePath, std::string key, uint64_t format,
+			std::vector<Level>& levels, const std::vector<std::vector<char>>& data)
+	{
+		uint64_t offset = 5 * sizeof(uint64_t) + key.size() + levels.size() * sizeof(Level);
+		for (auto&& level : levels) {
+			level.offset = offset;
+			offset += level.size;
+		}
+
+		BinaryWriter file;
+		if (!file.open(cachePath(sourcePath)))
+			return false;
+
+		file.putU64(MAGIC);
+		file.putU64(VERSION);
+		file.putStr(key);
+		file.putU64(format);
+		file.putU64(levels.size());
+		file.put(levels.data(), levels.size() * sizeof(Level));
+
+		for (auto&& pixels : data)
+			file.put(pixels.data(), pixels.size());
+
+		return file.commit();
+	}
+
+	/// false if there is no valid cache for the key, can be called from
+	/// any thread
+	static bool read (std::string sourcePath, std::string key, Image& image) {
+		if (!image.file.open(cachePath(sourcePath)))
+			return false;
+
+		BinaryReader reader(image.file.begin(), image.file.end());
+
+		if (reader.getU64() != MAGIC || reader.getU64() != VERSION || reader.getStr() != key)
+			return false;
+
+		image.format = reader.getU64();
+
+		uint64_t levelCount = reader.getCount(sizeof(Level));
+		image.levels.resize(levelCount);
+		reader.get(image.levels.data(), levelCount * sizeof(Level));
+
+		if (!reader.ok || levelCount == 0)
+			return false;
+
+		/// the chain upload expects: each level half the one above, down to
+		/// 1x1 at most, with rgba8 sizes matching their dimensions
+		uint64_t width = image.levels[0].width;
+		uint64_t height = image.levels[0].height;
+		if (width == 0 || height == 0 || width > MAX_SIZE || height > MAX_SIZE)
+			return false;
+
+		uint64_t maxLevels = 1;
+		while ((std::max(width, height) >> maxLevels) != 0)
+			maxLevels++;
+		if (levelCount > maxLevels)
+			return false;
+
+		for (uint64_t i = 0; i < levelCount; i++) {
+			const Level& level = image.levels[i];
+
+			if (level.width != std::max<uint64_t>(width >> i, 1) ||
+					level.height != std::max<uint64_t>(height >> i, 1))
+				return false;
+
+			if (image.format == 0 ? level.size != level.width * level.height * 4 :
+					level.size == 0 || level.size > INT32_MAX)
+				return false;
+
+			if (level.offset > image.file.size || image.file.size - level.offset < level.size)
+				return false;
+		}
+
+		return true;
+	}
+
+	/// call it on the gl thread
+	static Texture upload (const Image& image) {
+		Texture texture;
+		glGenTextures(1, (GLuint*)&texture.openglTexture);
+		glBindTexture(GL_TEXTURE_2D, texture.openglTexture);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, image.levels.size() - 1);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+		for (int i = 0; i < image.levels.size(); i++) {
+			const Level& level = image.levels[i];
+
+			if (image.format == 0)
+				glTexImage2D(GL_TEXTURE_2D, i, GL_RGBA, level.width, level.height, 0, GL_RGBA,
+						GL_UNSIGNED_BYTE, image.data(level));
+			else
+				glCompressedTexImage2D(GL_TEXTURE_2D, i, image.format, level.width, level.height,
+						0, level.size, image.data(level));
+		}
+
+		return texture;
+	}
+};
+
+#endif
@@ -0,0 +1,162 @@
+#ifndef TRIANGULATOR_H_INCLUDED
+#define TRIANGULATOR_H_INCLUDED
+
+#include <vector>
+#include <cmath>
+
+#include "MathLib.h"
+
+/// splits polygons in triangles that keep the winding of the polygon:
+/// convex ones in a fan from the first corner, concave ones by ear clipping
+/// in the plane of the polygon; the buffers are kept between calls so
+/// nothing is allocated once they are big enough
+class Triangulator {
+public:
+	/// corners projected on the plane of the polygon
+	std::vector <float> u;
+	std::vector <float> v;
+
+	/// corners not clipped yet
+	std::vector <int> remaining;
+
+	/// appends the corner indexes (0 to count - 1) of the triangles to out
+	void triangulate (const Math::Point3f *points, int count, std::vector<int>& out) {
+		if (count < 3)
+			return;
+
+		if (count == 3) {
+			fan(count, out);
+			return;
+		}
+
+		project(points, count);
+
+		float area = signedArea(count);
+		if (area == 0 || isConvex(count, area)) {
+			fan(count, out);
+			return;
+		}
+
+		earClip(count, area, out);
+	}
+
+	static void fan (int count, std::vector<int>& out) {
+		for (int i = 1; i + 1 < count; i++) {
+			out.push_back(0);
+			out.push_back(i);
+			out.push_back(i + 1);
+		}
+	}
+
+	/// drops the axis the polygon faces the most (newell normal)
+	void project (const Math::Point3f *points, int count) {
+		float normal[3] = {0, 0, 0};
+
+		for (int i = 0; i < count; i++) {
+			Math::Point3f cur = points[i];
+			Math::Point3f next = points[(i + 1) % count];
+			const float *a = cur.getPtr();
+			const float *b = next.getPtr();
+
+			normal[0] += (a[1] - b[1]) * (a[2] + b[2]);
+			normal[1] += (a[2] - b[2]) * (a[0] + b[0]);
+			normal[2] += (a[0] - b[0]) * (a[1] + b[1]);
+		}
+
+		int dropped = 0;
+		if (std::fabs(normal[1]) > std::fabs(normal[dropped]))
+			dropped = 1;
+		if (std::fabs(normal[2]) > std::fabs(normal[dropped]))
+			dropped = 2;
+
+		int uAxis = (dropped + 1) % 3;
+		int vAxis = (dropped + 2) % 3;
+
+		u.resize(count);
+		v.resize(count);
+		for (int i = 0; i < count; i++) {
+			Math::Point3f point = points[i];
+			u[i] = point.getPtr()[uAxis];
+			v[i] = point.getPtr()[vAxis];
+		}
+	}
+
+	float signedArea (int count) {
+		float area = 0;
+		for (int i = 0; i < count; i++) {
+			int j = (i + 1) % count;
+			area += u[i] * v[j] - u[j] * v[i];
+		}
+
+		return area / 2;
+	}
+
+	/// twice the signed area of a b c
+	float cross (int a, int b, int c) {
+		return (u[b] - u[a]) * (v[c] - v[a]) - (v[b] - v[a]) * (u[c] - u[a]);
+	}
+
+	/// every turn goes the way of the polygon (or is straight)
+	bool isConvex (int count, float area) {
+		for (int i = 0; i < count; i++) {
+			float turn = cross(i, (i + 1) % count, (i + 2) % count);
+			if (turn * area < 0)
+				return false;
+		}
+
+		return true;
+	}
+
+	/// p inside a b c or on its border, for a b c wound like the polygon
+	bool isInside (int p, int a, int b, int c, float area) {
+		return cross(a, b, p) * area >= 0 && cross(b, c, p) * area >= 0 &&
+				cross(c, a, p) * area >= 0;
+	}
+
+	void earClip (int count, float area, std::vector<int>& out) {
+		remaining.resize(count);
+		for (int i = 0; i < count; i++)
+			remaining[i] = i;
+
+		int i = 0;
+		int misses = 0;		/// corners looked at since the last ear
+
+		while (remaining.size() > 3) {
+			int size = remaining.size();
+			i %= size;
+
+			int a = remaining[(i + size - 1) % size];
+			int b = remaining[i];
+			int c = remaining[(i + 1) % size];
+
+			bool isEar = cross(a, b, c) * area > 0;
+			for (int j = 0; isEar && j < size; j++) {
+				int p = remaining[j];
+				if (p != a && p != b && p != c && isInside(p, a, b, c, area))
+					isEar = false;
+			}
+
+			if (isEar) {
+				out.push_back(a);
+				out.push_back(b);
+				out.push_back(c);
+				remaining.erase(remaining.begin() + i);
+				misses = 0;
+			}
+			else if (++misses > size) {
+				break;	/// self intersecting or degenerate, the rest goes in a fan
+			}
+			else {
+				i++;
+			}
+		}
+
+		for (int j = 1; j + 1 < remaining.size(); j++) {
+			out.push_back(remaining[0]);
+			out.push_back(remaining[j]);
+			out.push_back(remaining[j + 1]);
+		}
+	}
+};
+
+#endif
@@ -0,0 +1,122 @@
+#ifndef VERTEX_INDEX_MAP_H_INCLUDED
+#define VERTEX_INDEX_MAP_H_INCLUDED
+
+#include <vector>
+#include <cstdint>
+
+/// maps a (position, normal, texCoord) obj index triplet to the index of the
+/// vertex made from it; flat open addressing with linear probing, the three
+/// indexes are packed in a 96 bit key stored next to the value, so a probe
+/// touches a single 16 byte slot
+class VertexIndexMap {
+public:
+	struct Slot {
+		uint32_t a;
+		uint32_t b;
+		uint32_t c;
+		int32_t value;	/// EMPTY if the slot is free
+	};
+
+	static const int32_t EMPTY = -1;
+
+	std::vector <Slot> slots;
+	size_t count = 0;
+	size_t mask = 0;
+
+	VertexIndexMap() {}
+
+	/// makes room for count keys without growing
+	void reserve (size_t count) {
+		size_t capacity = 16;
+		while (capacity < count * 2)
+			capacity *= 2;
+
+		if (capacity > slots.size())
+			rehash(capacity);
+	}
+
+	size_t size() const {
+		return count;
+	}
+
+	void clear() {
+		slots.clear();
+		count = 0;
+		mask = 0;
+	}
+
+	/// returns the value of the key, if the key is missing newValue is
+	/// inserted and returned, a single probe sequence does both
+	int findOrInsert (int a, int b, int c, int newValue, bool& inserted) {
+		if ((count + 1) * 2 > slots.size())
+			rehash(slots.size() ? slots.size() * 2 : 16);
+
+		size_t pos = hash(a, b, c) & mask;
+		while (true) {
+			Slot& slot = slots[pos];
+
+			if (slot.value == EMPTY) {
+				slot = Slot{(uint32_t)a, (uint32_t)b, (uint32_t)c, newValue};
+				count++;
+				inserted = true;
+				return newValue;
+			}
+
+			if (slot.a == (uint32_t)a && slot.b == (uint32_t)b && slot.c == (uint32_t)c) {
+				inserted = false;
+				return slot.value;
+			}
+
+			pos = (pos + 1) & mask;
+		}
+	}
+
+	/// EMPTY if the key is missing
+	int find (int a, int b, int c) const {
+		if (slots.size() == 0)
+			return EMPTY;
+
+		size_t pos = hash(a, b, c) & mask;
+		while (slots[pos].value != EMPTY) {
+			const Slot& slot = slots[pos];
+
+			if (slot.a == (uint32_t)a && slot.b == (uint32_t)b && slot.c == (uint32_t)c)
+				return slot.value;
+
+			pos = (pos + 1) & mask;
+		}
+
+		return EMPTY;
+	}
+
+	static size_t hash (int a, int b, int c) {
+		uint64_t h = ((uint64_t)(uint32_t)a << 32) | (uint32_t)b;
+		h ^= (uint64_t)(uint32_t)c * 0x9E3779B97F4A7C15ull;
+		h ^= h >> 32;
+		h *= 0xD6E8FEB86659FD93ull;
+		h ^= h >> 32;
+
+		return h;
+	}
+
+	void rehash (size_t capacity) {
+		std::vector <Slot> old;
+		old.swap(slots);
+
+		slots.assign(capacity, Slot{0, 0, 0, EMPTY});
+		mask = capacity - 1;
+
+		for (auto&& slot : old) {
+			if (slot.value == EMPTY)
+				continue;
+
+			size_t pos = hash(slot.a, slot.b, slot.c) & mask;
+			while (slots[pos].value != EMPTY)
+				pos = (pos + 1) & mask;
+
+			slots[pos] = slot;
+		}
+	}
+};
+
+#endif
@@ -0,0 +1,579 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <map>
+#include <tuple>
+#include <vector>
+#include <fstream>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <string>
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#endif
+
+// names for the vertex
+struct VertexTexCoord {};
+struct VertexNormal {};
+struct VertexPosition {};
+struct VertexColor {};
+
+#include "VertexIndexMap.h"
+#include "ObjPrescan.h"
+#include "OBJLoader.h"
+
+using BenchVertex = Vertex<
+	Math::Point2f,	VertexTexCoord,
+	Math::Point3f,	VertexNormal,
+	Math::Point3f,	VertexPosition
+>;
+
+/// headless benchmarks for the loader internals, no window or gl context needed
+
+template <typename FuncType>
+double timeIt (FuncType&& func) {
+	auto start = std::chrono::steady_clock::now();
+	func();
+	auto end = std::chrono::steady_clock::now();
+
+	return std::chrono::duration<double>(end - start).count();
+}
+
+/// corner stream shaped like a closed triangle mesh: every vertex is used
+/// by about 6 corners, positions are reused with different normals at creases
+std::vector <int> makeCorners (int vertexCount, int cornerCount) {
+	std::mt19937 rng(1234);
+	std::vector <int> corners;
+	corners.reserve(cornerCount * 3);
+
+	for (int i = 0; i < cornerCount; i++) {
+		int base = (i / 6) % vertexCount;
+		int vertex = std::min(vertexCount - 1, (int)(base + rng() % 8));
+
+		corners.push_back(vertex + 1);
+		corners.push_back(vertex / 2 + 1 + (rng() % 16 == 0));
+		corners.push_back(vertex + 1);
+	}
+
+	return corners;
+}
+
+void benchVertexDedup (int vertexCount, int cornerCount) {
+	auto corners = makeCorners(vertexCount, cornerCount);
+	std::vector <int> faceIndex(cornerCount);
+	size_t mapUnique = 0;
+	size_t flatUnique = 0;
+
+	/// what OBJLoader did before VertexIndexMap: a find then an operator[]
+	double mapTime = timeIt([&] {
+		std::map <std::tuple<int, int, int>, int> indexMap;
+		std::vector <std::tuple<int, int, int>> indexes;
+
+		for (int i = 0; i < cornerCount; i++) {
+			auto key = std::make_tuple(corners[i * 3], corners[i * 3 + 1], corners[i * 3 + 2]);
+
+			if (indexMap.find(key) == indexMap.end()) {
+				indexes.push_back(key);
+				indexMap[key] = indexes.size() - 1;
+			}
+
+			faceIndex[i] = indexMap[key];
+		}
+
+		mapUnique = indexes.size();
+	});
+
+	double flatTime = timeIt([&] {
+		VertexIndexMap indexMap;
+		std::vector <std::tuple<int, int, int>> indexes;
+
+		indexMap.reserve(vertexCount * 2);
+		indexes.reserve(vertexCount * 2);
+
+		for (int i = 0; i < cornerCount; i++) {
+			bool inserted = false;
+			int index = indexMap.findOrInsert(corners[i * 3], corners[i * 3 + 1],
+					corners[i * 3 + 2], indexes.size(), inserted);
+
+			if (inserted)
+				indexes.push_back(std::make_tuple(corners[i * 3], corners[i * 3 + 1],
+						corners[i * 3 + 2]));
+
+			faceIndex[i] -= index;
+		}
+
+		flatUnique = indexes.size();
+	});
+
+	bool same = mapUnique == flatUnique;
+	for (auto&& diff : faceIndex)
+		same = same && diff == 0;
+
+	std::cout << std::fixed << std::setprecision(3)
+			<< "vertex dedup, " << cornerCount << " corners, " << mapUnique << " unique: "
+			<< "std::map " << mapTime << "s, "
+			<< "VertexIndexMap " << flatTime << "s, "
+			<< "speedup " << mapTime / flatTime << "x"
+			<< (same ? "" : " RESULTS DIFFER") << std::endl;
+}
+
+/// grid of quads, split in triangles, with a texture coordinate per position
+void writeGridObj (std::string path, int side) {
+	std::ofstream file(path.c_str());
+	char line[128];
+
+	for (int y = 0; y <= side; y++) {
+		for (int x = 0; x <= side; x++) {
+			snprintf(line, sizeof(line), "v %f %f %f\nvt %f %f\n",
+					x * 0.1f, y * 0.1f, (x ^ y) * 0.001f, x / (float)side, y / (float)side);
+			file << line;
+		}
+	}
+	file << "vn 0 0 1\n";
+
+	for (int y = 0; y < side; y++) {
+		for (int x = 0; x < side; x++) {
+			int a = y * (side + 1) + x + 1;
+			int b = a + 1;
+			int c = a + side + 1;
+			int d = c + 1;
+
+			snprintf(line, sizeof(line), "f %d/%d/1 %d/%d/1 %d/%d/1\nf %d/%d/1 %d/%d/1 %d/%d/1\n",
+					a, a, b, b, d, d, a, a, d, d, c, c);
+			file << line;
+		}
+	}
+}
+
+void benchPrescan (int side) {
+	std::string path = "bench_prescan.obj";
+	writeGridObj(path, side);
+
+	MappedFile file(path);
+	double megaBytes = file.size / 1e6;
+	const char *names[] = {"scalar", "sse2", "avx2"};
+
+	for (int impl = ObjPrescan::SCALAR; impl <= ObjPrescan::bestImpl(); impl++) {
+		ObjPrescan::Counts counts;
+		double time = timeIt([&] {
+			counts = ObjPrescan::count(file.begin(), file.end(), impl);
+		});
+
+		std::cout << std::fixed << std::setprecision(4)
+				<< "prescan " << names[impl] << ", " << megaBytes << " MB, "
+				<< counts.faces << " faces: " << time << "s, "
+				<< megaBytes / time << " MB/s" << std::endl;
+	}
+
+	/// what the count costs inside a load against what reserving saves
+	for (int usePrescan = 0; usePrescan < 2; usePrescan++) {
+		double time = timeIt([&] {
+			OBJLoader<BenchVertex> loader;
+			loader.usePrescan = usePrescan;
+			loader.loadMesh("", path);
+		});
+
+		std::cout << "load " << (usePrescan ? "with" : "without") << " prescan: "
+				<< time << "s" << std::endl;
+	}
+
+	file.close();
+	std::remove(path.c_str());
+}
+
+/// what the synthetic obj looks like, every option can be given on the
+/// command line as name=value
+struct ObjGenOptions {
+	long long faces = 10000;
+	bool texCoords = true;
+	bool normals = true;
+	int minArity = 3;			/// corners per face, picked uniformly
+	int maxArity = 4;
+	double negativeShare = 0;	/// share of faces written with relative indexes
+	int facesPerUsemtl = 0;		/// 0 for no usemtl lines
+	int materials = 8;			/// in the mtl written next to the obj
+	unsigned seed = 1;
+};
+
+/// buffered writer for the generator, the numbers are formatted by hand so
+/// 100M faces take seconds and not minutes
+class FastWriter {
+public:
+	FILE *file;
+	std::vector <char> buff;
+	size_t used = 0;
+
+	FastWriter (std::string path) : file(fopen(path.c_str(), "wb")), buff(1 << 20) {
+		if (!file)
+			throw std::runtime_error("can't write " + path);
+	}
+
+	~FastWriter() {
+		flush();
+		fclose(file);
+	}
+
+	void flush() {
+		fwrite(buff.data(), 1, used, file);
+		used = 0;
+	}
+
+	void put (char c) {
+		if (used == buff.size())
+			flush();
+		buff[used++] = c;
+	}
+
+	void put (const char *str) {
+		for (; *str; str++)
+			put(*str);
+	}
+
+	void putInt (long long value) {
+		char digits[24];
+		int count = 0;
+
+		if (value < 0) {
+			put('-');
+			value = -value;
+		}
+
+		do {
+			digits[count++] = '0' + value % 10;
+			value /= 10;
+		} while (value);
+
+		while (count)
+			put(digits[--count]);
+	}
+
+	/// 4 decimals
+	void putFixed (double value) {
+		long long scaled = llround(value * 10000);
+		if (scaled < 0) {
+			put('-');
+			scaled = -scaled;
+		}
+
+		putInt(scaled / 10000);
+		put('.');
+
+		long long frac = scaled % 10000;
+		for (long long div = 1000; div; div /= 10)
+			put('0' + frac / div % 10);
+	}
+};
+
+/// a deterministic obj for the options: vertexes come in about as fast as a
+/// closed mesh of that arity needs them (F * (arity / 2 - 1)) and faces use
+/// the last few of them, so the file has the locality and the vertex reuse
+/// of a real mesh; v, vt and vn share indexes
+void generateObj (std::string directory, std::string filename, const ObjGenOptions& options) {
+	std::mt19937 rng(options.seed);
+	auto uniform = [&] () {
+		return (rng() >> 8) * (1.0 / (1 << 24));
+	};
+
+	/// wide enough for the biggest face, the first face waits for that many
+	/// vertexes
+	const int WINDOW = std::max(32, options.maxArity);
+	long long vertexCount = 0;
+	double vertexDebt = WINDOW;
+
+	std::string mtlName = filename + ".mtl";
+	{
+		FastWriter mtl(directory + mtlName);
+		for (int i = 0; i < options.materials; i++) {
+			mtl.put("newmtl mat");
+			mtl.putInt(i);
+			mtl.put("\nKd ");
+			mtl.putFixed(uniform());
+			mtl.put(' ');
+			mtl.putFixed(uniform());
+			mtl.put(' ');
+			mtl.putFixed(uniform());
+			mtl.put("\nKs 0.5 0.5 0.5\nNs 64\nd 1\n");
+		}
+	}
+
+	FastWriter obj(directory + filename);
+	obj.put("mtllib ");
+	obj.put(mtlName.c_str());
+	obj.put('\n');
+
+	for (long long face = 0; face < options.faces; face++) {
+		int arity = options.minArity + rng() % (options.maxArity - options.minArity + 1);
+		vertexDebt += std::max(arity / 2.0 - 1, 0.0);
+
+		for (; vertexDebt >= 1 || vertexCount < options.maxArity; vertexDebt--) {
+			double x = (vertexCount % 1000) * 0.01;
+			double y = (vertexCount / 1000 % 1000) * 0.01;
+
+			obj.put("v ");
+			obj.putFixed(x + uniform() * 0.005);
+			obj.put(' ');
+			obj.putFixed(y + uniform() * 0.005);
+			obj.put(' ');
+			obj.putFixed(uniform());
+			obj.put('\n');
+
+			if (options.texCoords) {
+				obj.put("vt ");
+				obj.putFixed(uniform());
+				obj.put(' ');
+				obj.putFixed(uniform());
+				obj.put('\n');
+			}
+
+			if (options.normals) {
+				obj.put("vn ");
+				obj.putFixed(uniform() - 0.5);
+				obj.put(' ');
+				obj.putFixed(uniform() - 0.5);
+				obj.put(" 1\n");
+			}
+
+			vertexCount++;
+		}
+
+		if (options.facesPerUsemtl && face % options.facesPerUsemtl == 0) {
+			obj.put("usemtl mat");
+			obj.putInt(face / options.facesPerUsemtl % options.materials);
+			obj.put('\n');
+		}
+
+		/// distinct corners among the last WINDOW vertexes
+		long long window = std::min<long long>(WINDOW, vertexCount);
+		long long start = rng() % (window - arity + 1);
+		bool negative = uniform() < options.negativeShare;
+
+		obj.put('f');
+		for (int corner = 0; corner < arity; corner++) {
+			long long index = vertexCount - start - corner;
+			if (negative)
+				index -= vertexCount + 1;
+
+			obj.put(' ');
+			obj.putInt(index);
+			if (options.texCoords || options.normals) {
+				obj.put('/');
+				if (options.texCoords)
+					obj.putInt(index);
+				if (options.normals) {
+					obj.put('/');
+					obj.putInt(index);
+				}
+			}
+		}
+		obj.put('\n');
+	}
+}
+
+/// runs func in a child process so the peak rss is the one of func alone;
+/// func returns its time, -1 is returned if it threw or the child died,
+/// peakKB is 0 where getrusage is not available
+template <typename FuncType>
+double measure (FuncType&& func, long& peakKB) {
+	peakKB = 0;
+#ifndef _WIN32
+	int fds[2];
+	if (pipe(fds) != 0)
+		return func();
+
+	pid_t pid = fork();
+	if (pid == 0) {
+		close(fds[0]);
+
+		/// the child must never return into main
+		double time = 0;
+		try {
+			time = func();
+		}
+		catch (std::exception& e) {
+			std::cerr << e.what() << std::endl;
+			_exit(1);
+		}
+		catch (...) {
+			_exit(1);
+		}
+
+		if (write(fds[1], &time, sizeof(time)) != sizeof(time))
+			_exit(1);
+		_exit(0);
+	}
+
+	close(fds[1]);
+	double time = 0;
+	if (read(fds[0], &time, sizeof(time)) != sizeof(time))
+		time = -1;
+	close(fds[0]);
+
+	int status = 0;
+	struct rusage usage;
+	if (wait4(pid, &status, 0, &usage) == pid) {
+		peakKB = usage.ru_maxrss;
+		if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+			time = -1;
+	}
+
+	return time;
+#else
+	return func();
+#endif
+}
+
+long long fileSize (std::string path) {
+	std::ifstream file(path.c_str(), std::ios::binary | std::ios::ate);
+	return file ? (long long)file.tellg() : 0;
+}
+
+void benchLoader (const ObjGenOptions& options) {
+	std::string filename = "bench_gen.obj";
+	generateObj("", filename, options);
+
+	double megaBytes = fileSize(filename) / 1e6;
+	std::cout << "generated " << options.faces << " faces, arity " << options.minArity << "-"
+			<< options.maxArity << (options.texCoords ? ", vt" : "") << (options.normals ? ", vn" : "")
+			<< ", negative " << options.negativeShare << ", usemtl every " << options.facesPerUsemtl
+			<< ": " << megaBytes << " MB" << std::endl;
+
+	const char *modes[] = {"stream", "mapped", "threaded", "mapped+triangulate"};
+	for (int mode = 0; mode < 4; mode++) {
+		long peakKB = 0;
+		double time = measure([&] {
+			return timeIt([&] {
+				OBJLoader<BenchVertex> loader;
+				loader.loadMode = mode == 3 ? loader.LOAD_MAPPED : mode;
+				loader.triangulate = mode == 3;
+				loader.loadMesh("", filename);
+			});
+		}, peakKB);
+
+		if (time < 0) {
+			std::cout << "  OBJLoader " << modes[mode] << ": failed" << std::endl;
+			continue;
+		}
+
+		std::cout << std::fixed << std::setprecision(3)
+				<< "  OBJLoader " << modes[mode] << ": " << time << "s, "
+				<< megaBytes / time << " MB/s, " << options.faces / time / 1e6 << " M faces/s, "
+				<< "peak rss " << peakKB / 1024.0 << " MB" << std::endl;
+	}
+
+	std::remove(filename.c_str());
+	std::remove((filename + ".mtl").c_str());
+}
+
+void benchMtl (int materials) {
+	ObjGenOptions options;
+	options.faces = 1;
+	options.materials = materials;
+	generateObj("", "bench_mtl.obj", options);
+
+	std::string mtlName = "bench_mtl.obj.mtl";
+	double megaBytes = fileSize(mtlName) / 1e6;
+
+	long peakKB = 0;
+	double time = measure([&] {
+		return timeIt([&] {
+			MTLLoader loader;
+			loader.loadMtl("", mtlName);
+		});
+	}, peakKB);
+
+	if (time < 0)
+		std::cout << "MTLLoader, " << materials << " materials: failed" << std::endl;
+	else {
+		std::cout << std::fixed << std::setprecision(3)
+				<< "MTLLoader, " << materials << " materials: " << time << "s, "
+				<< megaBytes / time << " MB/s, " << materials / time / 1e6 << " M materials/s, "
+				<< "peak rss " << peakKB / 1024.0 << " MB" << std::endl;
+	}
+
+	std::remove("bench_mtl.obj");
+	std::remove(mtlName.c_str());
+}
+
+/// name=value arguments, see ObjGenOptions; arity is min-max
+ObjGenOptions parseOptions (int argc, char const *argv[], int first) {
+	ObjGenOptions options;
+
+	for (int i = first; i < argc; i++) {
+		std::string arg = argv[i];
+		size_t eq = arg.find('=');
+		std::string name = arg.substr(0, eq);
+		std::string value = eq == std::string::npos ? "" : arg.substr(eq + 1);
+
+		if (name == "faces")
+			options.faces = atof(value.c_str());
+		else if (name == "vt")
+			options.texCoords = atoi(value.c_str());
+		else if (name == "vn")
+			options.normals = atoi(value.c_str());
+		else if (name == "arity") {
+			options.minArity = atoi(value.c_str());
+			size_t dash = value.find('-');
+			options.maxArity = dash == std::string::npos ? options.minArity :
+					atoi(value.c_str() + dash + 1);
+		}
+		else if (name == "negative")
+			options.negativeShare = atof(value.c_str());
+		else if (name == "usemtl")
+			options.facesPerUsemtl = atoi(value.c_str());
+		else if (name == "materials")
+			options.materials = atoi(value.c_str());
+		else if (name == "seed")
+			options.seed = atoi(value.c_str());
+		else
+			throw std::runtime_error("unknown option " + arg);
+	}
+
+	options.minArity = std::max(options.minArity, 1);
+	options.maxArity = std::max(options.maxArity, options.minArity);
+	options.materials = std::max(options.materials, 1);
+
+	return options;
+}
+
+/// benchmark				internals and the loader at 10K, 100K and 1M faces
+/// benchmark loader [opts]	the loader on one generated file
+/// benchmark gen path [opts]	only writes the file (and path.mtl)
+int main (int argc, char const *argv[])
+{
+	std::string command = argc > 1 ? argv[1] : "";
+
+	if (command == "gen" && argc > 2) {
+		generateObj("", argv[2], parseOptions(argc, argv, 3));
+		return 0;
+	}
+
+	if (command == "loader") {
+		benchLoader(parseOptions(argc, argv, 2));
+		return 0;
+	}
+
+	/// first, the children of measure start with the memory of this process
+	for (long long faces : {10000ll, 100000ll, 1000000ll}) {
+		ObjGenOptions options;
+		options.faces = faces;
+		options.negativeShare = 0.25;
+		options.facesPerUsemtl = 1000;
+		benchLoader(options);
+	}
+
+	benchMtl(10000);
+
+	benchVertexDedup(10000, 60000);
+	benchVertexDedup(1000000, 6000000);
+	benchVertexDedup(5000000, 30000000);
+
+	benchPrescan(300);
+	benchPrescan(1500);
+
+	return 0;
+}